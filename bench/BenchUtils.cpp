@@ -0,0 +1,120 @@
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+namespace {
+
+std::atomic<std::size_t> alloc_count{0};
+std::atomic<std::size_t> alloc_bytes{0};
+
+} // anonymous namespace
+
+void * operator new(std::size_t size)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void * ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace bench {
+
+AllocStats alloc_stats() noexcept
+{
+    return {alloc_count.load(std::memory_order_relaxed), alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+Options Options::parse(int argc, char ** argv, unsigned default_max_dims)
+{
+    Options res;
+    res.max_dims = default_max_dims;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) {
+            res.filter = argv[++i];
+        } else if (arg == "--max-dims" && has_value) {
+            res.max_dims = std::stoul(argv[++i]);
+        } else if (arg == "--repeat" && has_value) {
+            res.repeat = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--csv") {
+            res.csv = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                << "Options: --filter <substring> --max-dims <n> --repeat <n> --csv\n";
+            std::exit(1);
+        }
+    }
+    return res;
+}
+
+Table::Table(std::vector<std::string> columns, std::size_t text_cols)
+    : m_columns(std::move(columns))
+    , m_text_cols(text_cols)
+{}
+
+Table & Table::operator<<(const std::string & cell)
+{
+    m_rows.back().push_back(cell);
+    return *this;
+}
+
+Table & Table::operator<<(double value)
+{
+    std::ostringstream ss;
+    ss << std::setprecision(4) << value;
+    return *this << ss.str();
+}
+
+Table & Table::operator<<(std::size_t value)
+{
+    return *this << std::to_string(value);
+}
+
+void Table::print(std::ostream & out, bool csv) const
+{
+    if (csv) {
+        auto print_line = [&](const std::vector<std::string> & cells) {
+            for (std::size_t i = 0; i < cells.size(); ++i) {
+                out << (i == 0 ? "" : ",") << cells[i];
+            }
+            out << '\n';
+        };
+        print_line(m_columns);
+        std::for_each(m_rows.begin(), m_rows.end(), print_line);
+        return;
+    }
+
+    std::vector<std::size_t> widths(m_columns.size());
+    for (std::size_t i = 0; i < m_columns.size(); ++i) {
+        widths[i] = m_columns[i].size();
+        for (const auto & row : m_rows) {
+            if (i < row.size()) {
+                widths[i] = std::max(widths[i], row[i].size());
+            }
+        }
+    }
+
+    auto print_line = [&](const std::vector<std::string> & cells) {
+        for (std::size_t i = 0; i < cells.size(); ++i) {
+            out << (i < m_text_cols ? std::left : std::right) << std::setw(widths[i]) << cells[i] << "  ";
+        }
+        out << '\n';
+    };
+    print_line(m_columns);
+    std::for_each(m_rows.begin(), m_rows.end(), print_line);
+}
+
+} // namespace bench
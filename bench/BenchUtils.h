@@ -0,0 +1,81 @@
+/*
+ *  Common parts of benchmark executables
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/*
+ * Heap allocations made since program start (global operator new is replaced)
+ */
+struct AllocStats
+{
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+
+    AllocStats operator-(const AllocStats & other) const noexcept { return {count - other.count, bytes - other.bytes}; }
+};
+
+AllocStats alloc_stats() noexcept;
+
+struct Timer
+{
+    using Clock = std::chrono::steady_clock;
+
+    Timer()
+        : m_start(Clock::now())
+    {}
+
+    double elapsed_ms() const { return std::chrono::duration<double, std::milli>(Clock::now() - m_start).count(); }
+
+private:
+    Clock::time_point m_start;
+};
+
+/*
+ * Command line options shared by benchmarks:
+ *  --filter <substring>    run only cases, which names contain substring
+ *  --max-dims <n>          upper bound of problem size
+ *  --repeat <n>            repeat every case, the best time is reported
+ *  --csv                   print comma-separated values instead of table
+ */
+struct Options
+{
+    std::string filter;
+    unsigned max_dims = 0;
+    unsigned repeat = 3;
+    bool csv = false;
+
+    static Options parse(int argc, char ** argv, unsigned default_max_dims);
+
+    bool matches(const std::string & name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+};
+
+/*
+ * Rows of results printed as aligned table or csv.
+ * First "text_cols" columns are aligned to the left, the rest (numbers) to the right.
+ */
+struct Table
+{
+    explicit Table(std::vector<std::string> columns, std::size_t text_cols = 1);
+
+    Table & row() { m_rows.emplace_back(); return *this; }
+    Table & operator<<(const std::string & cell);
+    Table & operator<<(double value);
+    Table & operator<<(std::size_t value);
+
+    void print(std::ostream & out, bool csv) const;
+
+private:
+    std::vector<std::string> m_columns;
+    std::size_t m_text_cols;
+    std::vector<std::vector<std::string>> m_rows;
+};
+
+} // namespace bench
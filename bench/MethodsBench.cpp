@@ -0,0 +1,445 @@
+/*
+ *  Benchmark of n-dimensional minimization methods on scalable test problems.
+ *  For every problem, size and method reports time, iterations,
+ *  function/gradient/hessian evaluations and heap allocations.
+ *  Then the smallest size of every problem is solved from many initial points
+ *  one by one and by batched searchers.
+ *  At last large sum-of-terms models are printed to file and loaded back by util::load_function.
+ */
+#include "BenchUtils.h"
+
+#include "methods/BatchedSearcher.h"
+#include "methods/Newton.h"
+#include "methods/QuasiNewton.h"
+#include "nd_methods/ConjugateGradient.h"
+#include "nd_methods/FastestDescent.h"
+#include "util/Function.h"
+#include "util/FunctionParser.h"
+#include "util/FunctionPasses.h"
+#include "util/ReplayData.h"
+#include "util/VectorOps.h"
+#include "util/VersionedData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double Eps = 0.000001;
+
+/*
+ * Calls of function (depth 0), its gradient's (depth 1) and hessian's (depth 2) components
+ */
+struct EvalCounters
+{
+    std::size_t calls[3] = {};
+};
+
+/*
+ * Transparent node, which counts its evaluations.
+ * Its derivatives are counted too, with depth increased.
+ */
+struct Counted : Fn
+{
+    Counted(std::unique_ptr<Fn> inner, EvalCounters & counters, unsigned depth)
+        : Fn(inner->dims())
+        , m_inner(std::move(inner))
+        , m_counters(&counters)
+        , m_depth(depth)
+    {}
+
+    double operator()(const util::VectorT & x) const noexcept override
+    {
+        ++m_counters->calls[m_depth];
+        return (*m_inner)(x);
+    }
+
+    // Forwarded, so batched line searches run the vectorized pass of the inner tree
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override
+    {
+        m_counters->calls[m_depth] += count;
+        m_inner->eval_batch(xs, count, out);
+    }
+
+    // Forwarded, so line searches get the exact derivative of the inner tree for one counted call
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override
+    {
+        ++m_counters->calls[m_depth];
+        return m_inner->eval_dual(x, dir);
+    }
+
+    std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override
+    {
+        // inner derivative is simplified here, since passes don't look inside custom nodes
+        auto der = simplify(*optimize_powers(*m_inner->part_der(idx)));
+        return std::make_unique<Counted>(std::move(der), *m_counters, std::min(m_depth + 1, 2u));
+    }
+
+    std::unique_ptr<Fn> clone() const noexcept override { return std::make_unique<Counted>(m_inner->clone(), *m_counters, m_depth); }
+    std::ostream & print(std::ostream & out) const override { return m_inner->print(out); }
+
+private:
+    std::unique_ptr<Fn> m_inner;
+    EvalCounters * m_counters;
+    unsigned m_depth;
+};
+
+/*
+ * Test problems
+ */
+struct Problem
+{
+    std::string name;
+    unsigned dims_step;         // problem is defined for dims divisible by this
+    unsigned max_dims;          // 0 if any
+    std::function<std::unique_ptr<Fn>(unsigned dims)> build;
+    std::function<util::VectorT(unsigned dims)> init;
+};
+
+// sum (100 * (x_2i+1 - x_2i ^ 2) ^ 2 + (1 - x_2i) ^ 2)
+std::unique_ptr<Fn> extended_rosenbrock(unsigned dims)
+{
+    std::vector<std::unique_ptr<Fn>> terms;
+    for (unsigned i = 0; i + 1 < dims; i += 2) {
+        terms.push_back(100. * ((var(i + 1) - (var(i) ^ 2)) ^ 2));
+        terms.push_back((1. - var(i)) ^ 2);
+    }
+    return sum(std::move(terms), std::vector<double>(dims, 1.));
+}
+
+// Extended Powell singular function, f3 for 4 dimensions
+std::unique_ptr<Fn> powell_singular(unsigned dims)
+{
+    std::vector<std::unique_ptr<Fn>> terms;
+    for (unsigned i = 0; i + 3 < dims; i += 4) {
+        terms.push_back((var(i) + (10. * var(i + 1))) ^ 2);
+        terms.push_back(5. * ((var(i + 2) - var(i + 3)) ^ 2));
+        terms.push_back((var(i + 1) - (2 * var(i + 2))) ^ 4);
+        terms.push_back(10 * ((var(i) - var(i + 3)) ^ 4));
+    }
+    return sum(std::move(terms), std::vector<double>(dims, 1.));
+}
+
+// f2
+std::unique_ptr<Fn> himmelblau(unsigned)
+{
+    return (((var(0) ^ 2) + var(1) - 11.) ^ 2) + ((var(0) + (var(1) ^ 2) - 7.) ^ 2);
+}
+
+// x^T A x / 2 - b^T x with random symmetric positive definite A = M^T M / dims + I
+std::unique_ptr<Fn> random_quadratic(unsigned dims)
+{
+    std::mt19937 gen(dims);
+    std::uniform_real_distribution<double> dist(-1., 1.);
+
+    std::vector<std::vector<double>> m(dims, std::vector<double>(dims));
+    for (auto & row : m) {
+        std::generate(row.begin(), row.end(), [&] { return dist(gen); });
+    }
+
+    std::vector<std::unique_ptr<Fn>> terms;
+    std::vector<double> coefs;
+    for (unsigned i = 0; i < dims; ++i) {
+        for (unsigned j = 0; j <= i; ++j) {
+            double a = (i == j ? 1. : 0.);
+            for (unsigned k = 0; k < dims; ++k) {
+                a += m[k][i] * m[k][j] / dims;
+            }
+            terms.push_back(i == j ? var(i) ^ 2 : var(i) * var(j));
+            coefs.push_back(i == j ? a / 2 : a);
+        }
+        terms.push_back(var(i));
+        coefs.push_back(-dist(gen));
+    }
+    return sum(std::move(terms), std::move(coefs));
+}
+
+std::vector<Problem> problems()
+{
+    auto repeated = [](util::VectorT pattern) {
+        return [pattern](unsigned dims) {
+            util::VectorT res(dims);
+            for (unsigned i = 0; i < dims; ++i) {
+                res[i] = pattern[i % pattern.size()];
+            }
+            return res;
+        };
+    };
+
+    return {
+        {"rosenbrock", 2, 0, extended_rosenbrock, repeated({-1.2, 1.})},
+        {"powell", 4, 0, powell_singular, repeated({3., -1., 0., 1.})},
+        {"himmelblau", 2, 2, himmelblau, repeated({0., 0.})},
+        {"quadratic", 1, 0, random_quadratic, repeated({0.})},
+    };
+}
+
+/*
+ * Methods under test: minimize function from init, iterations are counted by logged points
+ */
+struct Method
+{
+    std::string name;
+    std::function<util::VectorT(const Fn & func, util::VectorT init, const util::ReplayData *& replay)> run;
+};
+
+std::vector<Method> methods()
+{
+    auto newton = [](auto method) {
+        return [method](const Fn & func, util::VectorT init, const util::ReplayData *& replay) {
+            static NewtonMethods searcher(Eps);
+            replay = &searcher.replay_data();
+            return (searcher.*method)(func, std::move(init));
+        };
+    };
+    auto quasi = [](auto method) {
+        return [method](const Fn & func, util::VectorT init, const util::ReplayData *& replay) {
+            static QuasiNewton searcher(Eps);
+            replay = &searcher.replay_data();
+            return (searcher.*method)(func, std::move(init));
+        };
+    };
+    auto cg = [](min_nd::ConjugateGradient::Rule rule) {
+        return [rule](const Fn & func, util::VectorT init, const util::ReplayData *& replay) {
+            static min_nd::ConjugateGradient searcher(Eps);
+            searcher.set_rule(rule);
+            replay = &searcher.replay_data();
+            return searcher.find_min_traced(func, std::move(init));
+        };
+    };
+
+    return {
+        {"newton-classic", newton(&NewtonMethods::classic)},
+        {"newton-sd-search", newton(&NewtonMethods::with_sd_search)},
+        {"newton-desc-dir", newton(&NewtonMethods::with_desc_dir)},
+        {"quasi-bfs", quasi(&QuasiNewton::search_bfs)},
+        {"quasi-powell", quasi(&QuasiNewton::search_powell)},
+        {"quasi-bfs-batched", [](const Fn & func, util::VectorT init, const util::ReplayData *& replay) {
+            static QuasiNewton searcher(Eps);
+            searcher.set_batched_line_search(true);
+            replay = &searcher.replay_data();
+            return searcher.search_bfs(func, std::move(init));
+        }},
+        {"fastest-descent", [](const Fn & func, util::VectorT init, const util::ReplayData *& replay) {
+            static min_nd::FastestDescent searcher(Eps);
+            replay = &searcher.replay_data();
+            return searcher.find_min_traced(func, std::move(init));
+        }},
+        {"cg-fletcher-reeves", cg(min_nd::ConjugateGradient::Rule::FletcherReeves)},
+        {"cg-polak-ribiere", cg(min_nd::ConjugateGradient::Rule::PolakRibierePlus)},
+        {"cg-hager-zhang", cg(min_nd::ConjugateGradient::Rule::HagerZhang)},
+    };
+}
+
+/*
+ * Many small problems of the same function, solved one by one or by batched searcher
+ */
+constexpr std::size_t BatchSize = 4096;
+// Problem stopped by short step converged only if its gradient is short too
+constexpr double ConvergedGradNorm = 0.001;
+
+struct BatchMethod
+{
+    std::string name;
+    // Points are coordinate-major, found points are written back, returns number of converged problems
+    std::function<std::size_t(const Fn & func, util::VectorT & xs, std::size_t count)> run;
+};
+
+std::vector<BatchMethod> batch_methods()
+{
+    auto one_by_one = [](auto method) {
+        return [method](const Fn & func, util::VectorT & xs, std::size_t count) {
+            static auto searcher = method(Eps);
+            std::size_t converged = 0;
+            util::VectorT init(func.dims());
+            for (std::size_t k = 0; k < count; ++k) {
+                for (unsigned i = 0; i < func.dims(); ++i) {
+                    init[i] = xs[i * count + k];
+                }
+                auto res = searcher.minimize(func, init);
+                for (unsigned i = 0; i < func.dims(); ++i) {
+                    xs[i * count + k] = res.point[i];
+                }
+                converged += res.converged(ConvergedGradNorm);
+            }
+            return converged;
+        };
+    };
+    auto batched = [](BatchedSearcher::Method method) {
+        // closures of both methods have the same type, so searcher can't be a static local
+        auto searcher = std::make_shared<BatchedSearcher>(Eps, method);
+        return [searcher](const Fn & func, util::VectorT & xs, std::size_t count) {
+            return searcher->minimize(func, xs, count).converged(ConvergedGradNorm);
+        };
+    };
+
+    return {
+        {"newton-desc-dir", one_by_one([](double eps) { return BasicNewtonMethods<util::NoTrace>(eps); })},
+        {"quasi-bfs", one_by_one([](double eps) { return BasicQuasiNewton<util::NoTrace>(eps); })},
+        {"batched-newton", batched(BatchedSearcher::Method::Newton)},
+        {"batched-bfgs", batched(BatchedSearcher::Method::BFGS)},
+    };
+}
+
+// Initial points uniformly distributed in [-2, 2] cube around "center"
+util::VectorT batch_inits(const util::VectorT & center, std::size_t count)
+{
+    std::mt19937 gen(count);
+    std::uniform_real_distribution<double> dist(-2., 2.);
+    util::VectorT res(center.size() * count);
+    for (std::size_t i = 0; i < center.size(); ++i) {
+        std::generate_n(res.begin() + i * count, count, [&] { return center[i] + dist(gen); });
+    }
+    return res;
+}
+
+// Variables of models loaded from text
+constexpr unsigned ModelDims = 256;
+
+// Sum of "terms" weighted squares of differences of variables, the form of large fitting models
+std::unique_ptr<Fn> sum_of_terms(std::size_t terms)
+{
+    std::mt19937 gen(terms);
+    std::uniform_real_distribution<double> dist(0.5, 2.);
+    std::vector<std::unique_ptr<Fn>> parts;
+    std::vector<double> coefs;
+    for (std::size_t i = 0; i < terms; ++i) {
+        auto lhs = var(i % ModelDims), rhs = var((i * 7 + 1) % ModelDims);
+        parts.push_back((std::move(lhs) - std::move(rhs) + dist(gen)) ^ 2);
+        coefs.push_back(dist(gen));
+    }
+    return sum(std::move(parts), std::move(coefs));
+}
+
+std::size_t count_iterations(const util::ReplayData & replay)
+{
+    return std::count_if(replay.begin(), replay.end(), [](const auto & part) { return part.kind() == util::VdDataKind::VdPointKind; });
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    auto options = bench::Options::parse(argc, argv, 32);
+
+    bench::Table table({"problem", "method", "dims", "time_ms", "iters", "f_evals", "grad_evals", "hess_evals", "allocs", "alloc_kb", "f_min"}, 2);
+
+    for (const auto & problem : problems()) {
+        for (unsigned dims = std::max(problem.dims_step, 2u); dims <= options.max_dims; dims *= 2) {
+            if ((problem.max_dims != 0 && dims > problem.max_dims) || dims % problem.dims_step != 0) {
+                continue;
+            }
+
+            EvalCounters counters;
+            Counted func(problem.build(dims), counters, 0);
+
+            for (const auto & method : methods()) {
+                std::string name = problem.name + "/" + method.name + "/" + std::to_string(dims);
+                if (!options.matches(name)) {
+                    continue;
+                }
+
+                double best_ms = std::numeric_limits<double>::max();
+                bench::AllocStats allocs;
+                EvalCounters calls;
+                std::size_t iterations = 0;
+                double f_min = 0.;
+
+                for (unsigned rep = 0; rep < options.repeat; ++rep) {
+                    counters = {};
+                    const util::ReplayData * replay = nullptr;
+
+                    auto allocs_before = bench::alloc_stats();
+                    bench::Timer timer;
+                    auto res = method.run(func, problem.init(dims), replay);
+                    best_ms = std::min(best_ms, timer.elapsed_ms());
+
+                    allocs = bench::alloc_stats() - allocs_before;
+                    calls = counters;
+                    iterations = count_iterations(*replay);
+                    f_min = func(res);
+                }
+
+                table.row() << problem.name << method.name << std::size_t{dims} << best_ms << iterations
+                    << calls.calls[0] << calls.calls[1] / dims << calls.calls[2] / (dims * dims)
+                    << allocs.count << allocs.bytes / 1024. << f_min;
+            }
+        }
+    }
+
+    table.print(std::cout, options.csv);
+
+    bench::Table batch_table({"problem", "method", "dims", "problems", "time_ms", "us_per_problem", "converged", "f_max"}, 2);
+
+    for (const auto & problem : problems()) {
+        unsigned dims = std::max(problem.dims_step, 2u);
+        auto func = problem.build(dims);
+        auto inits = batch_inits(problem.init(dims), BatchSize);
+
+        for (const auto & method : batch_methods()) {
+            std::string name = "batch/" + problem.name + "/" + method.name + "/" + std::to_string(dims);
+            if (!options.matches(name)) {
+                continue;
+            }
+
+            double best_ms = std::numeric_limits<double>::max();
+            std::size_t converged = 0;
+            double f_max = 0.;
+            for (unsigned rep = 0; rep < options.repeat; ++rep) {
+                auto xs = inits;
+                bench::Timer timer;
+                converged = method.run(*func, xs, BatchSize);
+                best_ms = std::min(best_ms, timer.elapsed_ms());
+
+                util::VectorT values(BatchSize);
+                func->eval_batch(xs.data(), BatchSize, values.data());
+                f_max = *std::max_element(values.begin(), values.end());
+            }
+
+            batch_table.row() << problem.name << method.name << std::size_t{dims} << BatchSize << best_ms
+                << best_ms * 1000. / BatchSize << converged << f_max;
+        }
+    }
+
+    std::cout << '\n';
+    batch_table.print(std::cout, options.csv);
+
+    // load_function asserts, that parsed pages of models larger than two chunks are released
+    bench::Table parse_table({"model", "terms", "size_mb", "time_ms", "mb_per_s", "rel_error"}, 1);
+    const auto path = std::filesystem::temp_directory_path() / "newtone-bench-model.txt";
+
+    for (std::size_t terms : {10000, 100000, 300000}) {
+        if (!options.matches("parse/sum-of-terms/" + std::to_string(terms))) {
+            continue;
+        }
+        auto model = sum_of_terms(terms);
+        std::ofstream(path) << *model;
+        double size_mb = std::filesystem::file_size(path) / (1024. * 1024.);
+
+        double best_ms = std::numeric_limits<double>::max();
+        double rel_error = 0.;
+        for (unsigned rep = 0; rep < options.repeat; ++rep) {
+            bench::Timer timer;
+            auto loaded = util::load_function(path.string());
+            best_ms = std::min(best_ms, timer.elapsed_ms());
+
+            // printed coefficients are rounded
+            util::VectorT x(ModelDims, 0.5);
+            rel_error = loaded ? std::abs((*loaded)(x) / (*model)(x) - 1.) : std::numeric_limits<double>::infinity();
+        }
+        parse_table.row() << "sum-of-terms" << terms << size_mb << best_ms << size_mb * 1000. / best_ms << rel_error;
+    }
+    std::filesystem::remove(path);
+
+    std::cout << '\n';
+    parse_table.print(std::cout, options.csv);
+}
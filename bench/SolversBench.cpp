@@ -0,0 +1,330 @@
+/*
+ *  Benchmark of linear system solvers on every matrix storage format.
+ *  Sweeps matrix size, bandwidth and condition, for every case reports time, GFLOP/s,
+ *  multiplications counted by solver, refinement steps of mixed precision LU ("double" marks fallback
+ *  to double precision factorization), matrix footprint, heap allocations and residual.
+ *  The second table is matrix-vector product of large banded matrices with different number of threads.
+ *  The third one compares solving with several right parts: by solve_lu for every right part,
+ *  by single solves with one factorization and by one block solve.
+ */
+#include "BenchUtils.h"
+
+#include "sole-solver/Kernels.h"
+#include "sole-solver/ProfileMatrix.h"
+#include "sole-solver/QuadMatrix.h"
+#include "sole-solver/Solver.h"
+#include "sole-solver/SparseMatrix.h"
+#include "sole-solver/Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/*
+ * Kinds of generated matrices
+ */
+struct Kind
+{
+    std::string name;
+    std::function<QuadMatrix(std::size_t dim, std::size_t width)> generate;
+};
+
+std::vector<Kind> kinds()
+{
+    auto cond = [](int k) {
+        return [k](std::size_t dim, std::size_t width) { return Generator::generate_cond_matrix(dim, k, width); };
+    };
+
+    return {
+        {"random", [](std::size_t dim, std::size_t width) { return Generator::generate_quad_matrix(dim, width); }},
+        {"cond-0", cond(0)},
+        {"cond-8", cond(8)},
+        {"gilbert", [](std::size_t dim, std::size_t width) { return Generator::generate_gilbert_matrix(dim, width); }},
+    };
+}
+
+/*
+ * Storage formats: converts generated matrix and reports its footprint
+ */
+struct Format
+{
+    std::string name;
+    std::function<std::unique_ptr<Matrix>(const QuadMatrix & m, std::size_t & footprint)> convert;
+};
+
+template <class M>
+std::unique_ptr<Matrix> convert_to(const QuadMatrix & m, std::size_t & footprint)
+{
+    auto res = std::make_unique<M>(m);
+    footprint = res->footprint();
+    return res;
+}
+
+std::vector<Format> formats()
+{
+    return {
+        {"quad", convert_to<QuadMatrix>},
+        {"profile", convert_to<ProfileMatrix>},
+        {"sparse", convert_to<SparseMatrix>},
+    };
+}
+
+struct Method
+{
+    std::string name;
+    Solver::Result (*solve)(Matrix && a, std::vector<double> && b);
+};
+
+std::vector<Method> methods()
+{
+    return {
+        {"lu", Solver::solve_lu},
+        {"lu-refined", Solver::solve_lu_refined},
+        {"gauss", Solver::solve_gauss},
+    };
+}
+
+/*
+ * The dense operation count is used for all formats, so gflops of banded and sparse storages
+ * show the speedup over dense work: 2/3 n^3 for elimination and 2 n^2 for substitution.
+ * Multiplications counted by solvers over stored elements only are in the "actions" column.
+ */
+double nominal_flops(std::size_t dim)
+{
+    double n = dim;
+    return 2. / 3. * n * n * n + 2. * n * n;
+}
+
+// |a * x - b| / |b| in max-norm
+double relative_residual(const Matrix & a, const std::vector<double> & x, const std::vector<double> & b)
+{
+    auto ax = a * x;
+    double diff = 0., norm = 0.;
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        diff = std::max(diff, std::abs(ax[i] - b[i]));
+        norm = std::max(norm, std::abs(b[i]));
+    }
+    return norm > 0. ? diff / norm : diff;
+}
+
+/*
+ * The same matrix in sparse format, converted by stored elements,
+ * as conversion through the Matrix interface takes n^2 lookups
+ */
+SparseMatrix to_sparse(const ProfileMatrix & m)
+{
+    std::size_t dims = m.row_cnt();
+    std::size_t stored = m.row_end(dims - 1);
+    std::vector<std::size_t> j_prof(stored), i_prof(dims + 1);
+    for (std::size_t row = 0; row < dims; ++row) {
+        i_prof[row] = m.row_begin(row) + 1;
+        for (std::size_t pos = m.row_begin(row); pos < m.row_end(row); ++pos) {
+            j_prof[pos] = m.col_of(row, pos);
+        }
+    }
+    i_prof[dims] = stored + 1;
+    return SparseMatrix(
+        std::vector<double>(m.diagonal(), m.diagonal() + dims),
+        std::vector<double>(m.lower(), m.lower() + stored),
+        std::vector<double>(m.upper(), m.upper() + stored),
+        std::move(j_prof),
+        std::move(i_prof));
+}
+
+// Best time of "repeat" products in milliseconds
+template <class M>
+double product_ms(const M & m, const std::vector<double> & vec, std::vector<double> & out, unsigned threads, unsigned repeat)
+{
+    double best_ms = std::numeric_limits<double>::max();
+    for (unsigned rep = 0; rep < repeat; ++rep) {
+        bench::Timer timer;
+        Kernels::multiply(m, vec, out, threads);
+        best_ms = std::min(best_ms, timer.elapsed_ms());
+    }
+    return best_ms;
+}
+
+void run_products(const bench::Options & options)
+{
+    bench::Table table({"format", "width", "threads", "dims", "time_ms", "gflops", "footprint_kb"}, 1);
+
+    std::vector<unsigned> thread_counts{1};
+    if (std::thread::hardware_concurrency() > 1) {
+        thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+
+    const std::size_t width = 64;
+    // Solvers are cubic, products are linear, so they are run on much larger matrices
+    for (std::size_t dims = 4096; dims <= options.max_dims * std::size_t{1024}; dims *= 4) {
+        Generator::rand_gen.seed(dims);
+        ProfileMatrix profile = Generator::generate_profile_matrix(dims, width);
+        SparseMatrix sparse = to_sparse(profile);
+        std::vector<double> vec = Generator::generate_vector(dims);
+        std::vector<double> out;
+
+        // one multiplication and one addition for every stored element
+        double flops = 2. * (dims + 2 * profile.row_end(dims - 1));
+        for (unsigned threads : thread_counts) {
+            auto report = [&](const std::string & format, double ms, std::size_t footprint) {
+                table.row() << format << width << std::size_t{threads} << dims << ms << flops / (ms * 1e6) << footprint / 1024.;
+            };
+            auto matches = [&](const std::string & format) {
+                return options.matches("product/" + format + "/" + std::to_string(threads) + "/" + std::to_string(dims));
+            };
+            if (matches("profile")) {
+                report("profile", product_ms(profile, vec, out, threads, options.repeat), profile.footprint());
+            }
+            if (matches("sparse")) {
+                report("sparse", product_ms(sparse, vec, out, threads, options.repeat), sparse.footprint());
+            }
+        }
+    }
+
+    table.print(std::cout, options.csv);
+}
+
+/*
+ * Solve systems with "count" right parts, returns the best time in milliseconds
+ */
+template <class M>
+double right_parts_ms(const M & matrix, const std::string & method, std::size_t count, unsigned repeat)
+{
+    std::size_t dims = matrix.row_cnt();
+    std::vector<std::vector<double>> rights(count);
+    for (auto & right : rights) {
+        right = Generator::generate_vector(dims);
+    }
+    std::vector<double> block(dims * count);
+
+    double best_ms = std::numeric_limits<double>::max();
+    for (unsigned rep = 0; rep < repeat; ++rep) {
+        bench::Timer timer;
+        if (method == "solve_lu") {
+            for (const auto & right : rights) {
+                Solver::solve_lu(M(matrix), std::vector<double>(right));
+            }
+        } else {
+            auto factorization = Solver::factorize_lu(M(matrix));
+            if (method == "factorized") {
+                for (const auto & right : rights) {
+                    factorization.solve(right);
+                }
+            } else {
+                for (std::size_t i = 0; i < dims; ++i) {
+                    for (std::size_t k = 0; k < count; ++k) {
+                        block[i * count + k] = rights[k][i];
+                    }
+                }
+                factorization.solve(block, count);
+            }
+        }
+        best_ms = std::min(best_ms, timer.elapsed_ms());
+    }
+    return best_ms;
+}
+
+void run_right_parts(const bench::Options & options)
+{
+    bench::Table table({"width", "format", "method", "dims", "count", "time_ms", "per_right_us"}, 3);
+
+    const std::size_t dims = options.max_dims;
+    for (std::size_t width : {dims, std::size_t{8}}) {
+        Generator::rand_gen.seed(dims);
+        QuadMatrix matrix = Generator::generate_cond_matrix(dims, 0, width);
+        ProfileMatrix profile(matrix);
+        SparseMatrix sparse(matrix);
+
+        std::string width_name = width == dims ? "full" : std::to_string(width);
+        for (std::size_t count : {std::size_t{1}, std::size_t{8}, std::size_t{64}}) {
+            for (const std::string method : {"solve_lu", "factorized", "block"}) {
+                auto run = [&](const std::string & format, const auto & stored) {
+                    std::string name = "rhs/" + width_name + "/" + format + "/" + method + "/" + std::to_string(count);
+                    if (!options.matches(name)) {
+                        return;
+                    }
+                    double ms = right_parts_ms(stored, method, count, options.repeat);
+                    table.row() << width_name << format << method << dims << count << ms << ms * 1e3 / count;
+                };
+                run("quad", matrix);
+                run("profile", profile);
+                run("sparse", sparse);
+            }
+        }
+    }
+
+    table.print(std::cout, options.csv);
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    auto options = bench::Options::parse(argc, argv, 128);
+
+    bench::Table table({"matrix", "width", "format", "method", "dims", "time_ms", "gflops", "actions", "refine", "footprint_kb", "alloc_kb", "residual"}, 4);
+
+    for (const auto & kind : kinds()) {
+        for (std::size_t dims = 32; dims <= options.max_dims; dims *= 2) {
+            for (std::size_t width : {dims, std::size_t{8}}) {
+                Generator::rand_gen.seed(dims);
+                QuadMatrix matrix = kind.generate(dims, width);
+                std::vector<double> answer = Generator::generate_vector(dims);
+
+                std::string width_name = width == dims ? "full" : std::to_string(width);
+                for (const auto & format : formats()) {
+                    for (const auto & method : methods()) {
+                        std::string name = kind.name + "/" + width_name + "/" + format.name + "/" + method.name + "/" + std::to_string(dims);
+                        if (!options.matches(name)) {
+                            continue;
+                        }
+
+                        // conversion may drop elements, so the right part is built for the stored matrix
+                        std::size_t footprint = 0;
+                        auto stored = format.convert(matrix, footprint);
+                        std::vector<double> right = *stored * answer;
+
+                        double best_ms = std::numeric_limits<double>::max();
+                        bench::AllocStats allocs;
+                        Solver::Result res;
+
+                        for (unsigned rep = 0; rep < options.repeat; ++rep) {
+                            // solvers change the matrix in place, so it is converted again for every run
+                            auto converted = format.convert(matrix, footprint);
+                            auto b = right;
+
+                            auto allocs_before = bench::alloc_stats();
+                            bench::Timer timer;
+                            res = method.solve(std::move(*converted), std::move(b));
+                            best_ms = std::min(best_ms, timer.elapsed_ms());
+                            allocs = bench::alloc_stats() - allocs_before;
+                        }
+
+                        bool failed = res.actions == Solver::Result::FAILED;
+                        table.row() << kind.name << width_name << format.name << method.name << dims << best_ms
+                            << nominal_flops(dims) / (best_ms * 1e6)
+                            << (failed ? std::string("failed") : std::to_string(res.actions))
+                            << std::to_string(res.refinements) + (res.double_fallback ? " double" : "")
+                            << footprint / 1024. << allocs.bytes / 1024.
+                            << (failed ? std::numeric_limits<double>::quiet_NaN() : relative_residual(*stored, res.answer, right));
+                    }
+                }
+            }
+        }
+    }
+
+    table.print(std::cout, options.csv);
+    std::cout << '\n';
+
+    run_products(options);
+    std::cout << '\n';
+
+    run_right_parts(options);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "util/Function.h"
+#include "util/Optimizer.h"
+#include "util/VectorOps.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/*
+ * Newton and BFGS methods for many small independent problems of the same function,
+ * advanced in lock-step.
+ * Problems differ in initial points and, optionally, in parameters: variables after the first "vars"
+ * are not optimized, so one expression describes a family of problems.
+ * State of all problems is stored coordinate-major (structure of arrays, see Func<0>::eval_batch):
+ * function, gradient and hessian are evaluated by one batched pass over their trees,
+ * and linear solves and updates run over problems in vectorizable loops.
+ * Problems, which have stopped, are dropped from the batch and the rest are compacted.
+ * Nothing is traced, line search backtracks from the full step until function decreases enough.
+ */
+struct BatchedSearcher
+{
+    enum struct Method
+    {
+        Newton,
+        BFGS,
+    };
+
+    // Outcome of every problem, in the order of problems
+    struct Result
+    {
+        util::VectorT values;                   // function's value in the found point
+        util::VectorT grad_norms;               // gradient's length in the found point
+        std::vector<unsigned> iterations;
+        std::vector<util::StopReason> reasons;
+
+        // Problems stopped by gradient, or by step with gradient shorter than "grad_norm"
+        std::size_t converged(double grad_norm) const noexcept;
+    };
+
+    /*
+     * By default problem stops, when step is shorter than "eps", or after MaxIter iterations,
+     * like the single problem searchers
+     */
+    explicit BatchedSearcher(double eps, Method method = Method::Newton);
+
+    std::string_view method_name() const noexcept;
+
+    // Gradient norm, step and iterations criteria are supported
+    void set_stop_criteria(const util::StopCriteria & criteria) noexcept { m_criteria = criteria; }
+    const util::StopCriteria & stop_criteria() const noexcept { return m_criteria; }
+
+    /*
+     * Minimize "func" in "count" problems: xs[i * count + k] is the i-th coordinate of the k-th problem,
+     * found points are written back to "xs". Only the first "vars" coordinates are optimized (all, if 0).
+     */
+    Result minimize(const Function & func, util::VectorT & xs, std::size_t count, unsigned vars = 0);
+
+private:
+    static constexpr unsigned MaxIter = 3000;
+    static constexpr unsigned MaxBacktracks = 40;
+    static constexpr double ArmijoRatio = 1e-4;     // part of linear decrease required from step
+
+    // Directions of active problems: Newton's one or anti-hessian times antigradient
+    void count_directions(const Func<2> & hessian, std::size_t active, unsigned vars);
+    // Backtracking line search, moves active problems to the accepted points
+    void line_search(const Function & func, std::size_t active, unsigned dims, unsigned vars);
+    // BFGS update of anti-hessians by differences of points and gradients
+    void update_anti_hessians(std::size_t active, unsigned vars);
+    // Keep only listed problems in the batch
+    void compact(const std::vector<std::size_t> & keep, std::size_t active, unsigned dims, unsigned vars);
+
+private:
+    util::StopCriteria m_criteria;
+    Method m_method;
+
+    // Buffers of active problems, coordinate-major, reused between iterations
+    std::vector<std::size_t> m_problems;    // index of problem in the input
+    util::VectorT m_x;                      // points with parameters, dims x active
+    util::VectorT m_values;
+    util::VectorT m_grad;                   // vars x active
+    util::VectorT m_next_grad;
+    util::VectorT m_dir;
+    util::VectorT m_matrix;                 // hessian or anti-hessian, vars x vars x active
+    util::VectorT m_step;                   // accepted step length of each problem, negative if line search failed
+    util::VectorT m_alpha;                  // step coefficient along direction
+    util::VectorT m_der;                    // directional derivative
+    util::VectorT m_trial;                  // trial points of line search
+    util::VectorT m_trial_values;
+    util::VectorT m_grad_diff;              // differences of gradients for BFGS update
+    util::VectorT m_product;                // anti-hessian times gradients' difference
+    util::VectorT m_lane;                   // scratch values per problem
+    util::VectorT m_lane_aux;
+};
@@ -9,9 +9,11 @@
 /*
  * Standard newton methods' implementation
  */
-struct NewtonMethods : Searcher
+template <class Trace = util::FullTrace>
+struct BasicNewtonMethods : Searcher<Trace>
 {
-    using Searcher::Searcher;
+    using Super = Searcher<Trace>;
+    using Super::Super;
 
     // Classic newton method
     std::vector<double> classic(const Function & func, std::vector<double> init = {});
@@ -20,4 +22,34 @@ struct NewtonMethods : Searcher
     // Newton method with descent direction choice
     std::vector<double> with_desc_dir(const Function & func, std::vector<double> init = {});
 
+    enum struct Variant
+    {
+        Classic,
+        SdSearch,
+        DescDir,
+    };
+    // Method used by minimize()
+    void set_variant(Variant variant) noexcept { m_variant = variant; }
+
+    std::string_view method_name() const noexcept override;
+
+protected:
+    util::VectorT minimize_impl(const Function & func, util::VectorT init) override;
+
+private:
+    using Super::init_method;
+    using Super::find_alpha;
+    using Super::log_x;
+    using Super::log_alpha;
+    using Super::save_state;
+    using Super::m_stats;
+    using Super::m_termination;
+
+    Variant m_variant = Variant::DescDir;
 };
+
+extern template struct BasicNewtonMethods<util::FullTrace>;
+extern template struct BasicNewtonMethods<util::NoTrace>;
+extern template struct BasicNewtonMethods<util::SampledTrace>;
+
+using NewtonMethods = BasicNewtonMethods<>;
@@ -9,17 +9,32 @@
 /*
  * Quasinewton methods' implementation
  */
-struct QuasiNewton : Searcher
+template <class Trace = util::FullTrace>
+struct BasicQuasiNewton : Searcher<Trace>
 {
-    using Searcher::Searcher;
+    using Super = Searcher<Trace>;
+    using Super::Super;
+    using typename Super::PointT;
 
 private:
+    using Super::init_method;
+    using Super::find_exact_alpha;
+    using Super::log_x;
+    using Super::save_state;
+    using Super::warm_state;
+    using Super::m_eps;
+    using Super::m_stats;
+    using Super::m_termination;
+
+public:
     // enum to trace current method
     enum struct UpdateRule
     {
         BFSh,
         Powell,
     };
+
+private:
     // Broyden-Fletcher-Shanno algorithm
     util::MatrixT bfs(util::MatrixT anti_hessian, util::VectorT w_diff, const util::VectorT & x_diff);
     // Powell algorithm
@@ -32,4 +47,21 @@ public:
     // public wrappers for methods
     PointT search_bfs(const Function & func, PointT init = {}) { return search_common(UpdateRule::BFSh, func, std::move(init)); }
     PointT search_powell(const Function & func, PointT init = {}) { return search_common(UpdateRule::Powell, func, std::move(init)); }
+
+    // Method used by minimize()
+    void set_update_rule(UpdateRule rule) noexcept { m_rule = rule; }
+
+    std::string_view method_name() const noexcept override;
+
+protected:
+    PointT minimize_impl(const Function & func, PointT init) override { return search_common(m_rule, func, std::move(init)); }
+
+private:
+    UpdateRule m_rule = UpdateRule::BFSh;
 };
+
+extern template struct BasicQuasiNewton<util::FullTrace>;
+extern template struct BasicQuasiNewton<util::NoTrace>;
+extern template struct BasicQuasiNewton<util::SampledTrace>;
+
+using QuasiNewton = BasicQuasiNewton<>;
@@ -1,42 +1,110 @@
 #pragma once
 
+#include "sd_methods/BatchedSearch.h"
+#include "sd_methods/Bracketing.h"
 #include "sd_methods/Brent.h"
 #include "util/Function.h"
+#include "util/Instrument.h"
+#include "util/Optimizer.h"
 #include "util/ReplayData.h"
+#include "util/TracePolicy.h"
 
 /*
- * Base class for Newton methods implementations
+ * Base class for Newton methods implementations.
+ * "Trace" policy (see util/TracePolicy.h) chooses iterations, which are logged to replay data.
+ * By default search stops, when step is shorter than "eps", or after MaxIter iterations.
  */
-struct Searcher
+template <class Trace = util::FullTrace>
+struct Searcher : util::Optimizer
 {
     using PointT = std::vector<double>;
 
-    Searcher(double eps)
+    Searcher(double eps, Trace trace = {})
         : m_eps(eps)
+        , m_trace(trace)
         , m_sd_searcher(m_eps)
-    {}
+        , m_batched_searcher(m_eps)
+    {
+        m_criteria.step = eps;
+        m_criteria.max_iterations = MaxIter;
+    }
 
     const Function & last_func() const noexcept { return *m_last_func; }
     const util::ReplayData & replay_data() const noexcept { return m_replay_data; }
+    // Mutable trace, to stream it to file or attach exporter before search
+    util::ReplayData & replay_data() noexcept { return m_replay_data; }
+    // Evaluation counters and phase timings of the last search (empty without NEWTONE_INSTRUMENT)
+    const util::SearchStats & stats() const noexcept { return m_stats; }
+
+    /*
+     * Line search by rounds of batched probes (see min1d::BatchedSearch) instead of Brent's method,
+     * probes of a round are evaluated by one pass over the expression tree
+     */
+    void set_batched_line_search(bool batched) noexcept { m_batched_line_search = batched; }
 
 protected:
-    // Initialize values before starting method
+    // Initialize values before starting method, restores line search from warm start state
     PointT init_method(const Function & func, PointT init);
+    // Remember state at the end of search, "curvature" is empty, if method doesn't estimate it
+    void save_state(const PointT & curr, util::MatrixT curvature = {});
 
-    // Find coefficient alpha by solving one-dimensional minimization problem
-    double find_alpha(const PointT & curr, const std::vector<double> & shift);
+    /*
+     * Find coefficient alpha by solving one-dimensional minimization problem
+     * on segment found by bracketing from the previous alpha.
+     * Its tolerance follows directional derivative, but is never worse than "max_eps".
+     */
+    double find_alpha(const PointT & curr, const std::vector<double> & shift, double max_eps = LineSearchMaxEps);
+    /*
+     * Find coefficient alpha with full precision on the fixed segment [0, ExactSegment],
+     * for updates, which need the minimum along the whole segment rather than the nearest one
+     */
+    double find_exact_alpha(const PointT & curr, const std::vector<double> & shift);
 
     // Log current point
-    void log_x(unsigned iter_num, const std::vector<double> & x);
+    void log_x(unsigned iter_num, const std::vector<double> & x)
+    {
+        if constexpr (Trace::Enabled) {
+            if (m_trace.should_log(iter_num)) {
+                m_replay_data.add_comment(iter_num, "x:");
+                m_replay_data.add_point(iter_num, x);
+            }
+        }
+    }
     // Log current alpha coefficient
-    void log_alpha(unsigned iter_num, double alpha);
+    void log_alpha(unsigned iter_num, double alpha)
+    {
+        if constexpr (Trace::Enabled) {
+            if (m_trace.should_log(iter_num)) {
+                m_replay_data.add_comment(iter_num, "alpha:");
+                m_replay_data.add_value(iter_num, alpha);
+            }
+        }
+    }
 
 protected:
     static constexpr unsigned MaxIter = 3000;       // Maximum iterations treshold
+    static constexpr double LineSearchMaxEps = 1e-3;
+    static constexpr double ExactSegment = 10.;
 
     double m_eps;                                   // Current precision
+    Trace m_trace;                                  // Which iterations are logged
 
     const Function * m_last_func = nullptr;         // Minimum of this function is searched now
     util::ReplayData m_replay_data;                 // Object for recording tracing information
+    util::SearchStats m_stats;                      // Instrumentation of the last search
+    min1d::Bracketing m_bracketing;                 // Segment of one-dimensional minimization problem
     min1d::Brent m_sd_searcher;                     // One-dimensional minimization problem solver
+    min1d::BatchedSearch m_batched_searcher;        // Its batched alternative
+    bool m_batched_line_search = false;
+    std::vector<double> m_batch_points;             // Points of the line search round, coordinate-major
+
+private:
+    // Function's value in point curr + alpha * shift
+    double value_along(const PointT & curr, const std::vector<double> & shift, double alpha);
+    // Its values for "count" alphas at once
+    void values_along(const PointT & curr, const std::vector<double> & shift, const double * alphas, std::size_t count, double * out);
 };
+
+extern template struct Searcher<util::FullTrace>;
+extern template struct Searcher<util::NoTrace>;
+extern template struct Searcher<util::SampledTrace>;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "nd_methods/MinSearcher.h"
+#include "sd_methods/Bracketing.h"
+#include "sd_methods/Brent.h"
+#include "sd_methods/Function.h"
+
+#include "util/Function.h"
+#include "util/Misc.h"
+#include "util/VectorOps.h"
+
+namespace min_nd {
+
+/*
+ * Nonlinear conjugate gradient methods.
+ * Direction is antigradient corrected by the previous direction: d = -g + beta * d,
+ * rules differ in the choice of beta. Only a few vectors are stored, so memory is O(n),
+ * buffers are allocated once per search and iterations don't allocate.
+ * Direction is reset to antigradient every "restart" iterations,
+ * when successive gradients are far from orthogonal or when direction is not the descent one.
+ */
+struct ConjugateGradient : MinSearcher
+{
+    enum struct Rule
+    {
+        FletcherReeves,     // beta = |g'|^2 / |g|^2
+        PolakRibierePlus,   // beta = max(0, g' * (g' - g) / |g|^2)
+        HagerZhang,         // beta = (y - 2 d |y|^2 / (d * y)) * g' / (d * y), y = g' - g, bounded below
+    };
+
+    /*
+     * "restart" is number of iterations between restarts, dimension of function if 0,
+     * "init_step" is the first step along antigradient
+     */
+    ConjugateGradient(double eps, Rule rule = Rule::HagerZhang, unsigned restart = 0, double init_step = 1.)
+        : MinSearcher(eps)
+        , m_sd_searcher(eps)
+        , m_eps(eps)
+        , m_rule(rule)
+        , m_restart(restart)
+        , m_init_step(init_step)
+    {}
+
+    std::string_view method_name() const noexcept override;
+
+    void set_rule(Rule rule) noexcept { m_rule = rule; }
+
+    // Number of restarts made by the last search
+    unsigned restarts() const noexcept { return m_restarts; }
+
+protected:
+    /*
+     * Find n-dimensional function's minimum
+     * using conjugate gradient method.
+     */
+    util::VectorT find_min_impl(util::VectorT init, bool traced) override;
+
+private:
+    // Common code of traced and untraced versions, logging is compiled away for NoTrace policy
+    template <class Trace>
+    util::VectorT search(util::VectorT init, Trace trace);
+
+    // Coefficient of the previous direction, m_grad is the previous gradient, "next_grad" is the current one
+    double count_beta(const util::VectorT & next_grad) const noexcept;
+
+private:
+    min1d::Bracketing m_bracketing; // Segment of one dimensional minimization problem
+    min1d::Brent m_sd_searcher;     // One dimensional minimization method
+    double m_eps;
+    Rule m_rule;
+    unsigned m_restart;
+    double m_init_step;
+    unsigned m_restarts = 0;
+
+    // Buffers of the search, reused between iterations
+    util::VectorT m_curr;           // current point
+    util::VectorT m_grad;           // gradient in current point
+    util::VectorT m_next_grad;      // gradient in the next point
+    util::VectorT m_dir;            // current direction
+    util::VectorT m_point;          // point of line search
+};
+
+} // namespace min_nd
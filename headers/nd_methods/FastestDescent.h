@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MinSearcher.h"
+#include "sd_methods/Bracketing.h"
 #include "sd_methods/Brent.h"
 #include "sd_methods/Function.h"
 #include "sd_methods/MinSearcher.h"
@@ -13,39 +14,50 @@ namespace min_nd {
 
 struct FastestDescent : MinSearcher
 {
-    FastestDescent(double eps, double max_step = 10.)
-        : m_sd_searcher(eps)
+    /*
+     * "init_step" is the first step along antigradient,
+     * the next ones are guessed from the previous steps
+     */
+    FastestDescent(double eps, double init_step = 1.)
+        : MinSearcher(eps)
+        , m_sd_searcher(eps)
         , m_eps(eps)
-        , m_alpha(max_step)
+        , m_init_step(init_step)
     {}
 
+    std::string_view method_name() const noexcept override;
+
 protected:
-    /*
-     * Find n-dimensional function's minimum 
-     * using fastest descent method.
-     */
-    util::VectorT find_min_impl() override;
     /*
      * Find n-dimensional function's minimum
      * using fastest descent method.
-     * Outputs tracing information.
      */
-    util::VectorT find_min_traced_impl(util::VectorT init) override;
+    util::VectorT find_min_impl(util::VectorT init, bool traced) override;
 
 protected:
     /*
-     * Solve the one dimensional minimization problem.
+     * Solve the one dimensional minimization problem on bracketed segment.
      */
-    double find_sd_min(min1d::Function && func) { return m_sd_searcher.find_min(std::move(func)); }
+    double find_sd_min(min1d::Function && func, const min1d::Bracketing::Bracket & bracket)
+    {
+        util::PhaseTimer timer(util::Phase::LineSearch);
+        return m_sd_searcher.find_min(std::move(func), bracket);
+    }
     /*
      * Returns function for which one dimensional minimization problem was solved.
      */
     const min1d::Function & last_sd_func() const noexcept { return m_sd_searcher.last_func(); }
 
 private:
+    // Common code of traced and untraced versions, logging is compiled away for NoTrace policy
+    template <class Trace>
+    util::VectorT search(util::VectorT init, Trace trace);
+
+private:
+    min1d::Bracketing m_bracketing; // Segment of one dimensional minimization problem
     min1d::Brent m_sd_searcher;     // Current one dimensional minimization method
     double m_eps;
-    double m_alpha;
+    double m_init_step;
 };
 
 } // namespace min_nd
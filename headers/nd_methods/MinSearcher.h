@@ -1,42 +1,73 @@
 #pragma once
 
 #include "util/Function.h"
+#include "util/Instrument.h"
+#include "util/Optimizer.h"
 #include "util/ReplayData.h"
+#include "util/TracePolicy.h"
 #include "util/VectorOps.h"
 
 #include <vector>
 
 namespace min_nd {
 
-struct MinSearcher
+/*
+ * Base of n-dimensional searchers.
+ * By default search stops, when gradient is shorter than "eps", or after MAX_ITER iterations.
+ */
+struct MinSearcher : util::Optimizer
 {
-    util::VectorT find_min() { return find_min_impl(); }
+    explicit MinSearcher(double eps)
+    {
+        m_criteria.grad_norm = eps;
+        m_criteria.max_iterations = MAX_ITER;
+    }
+
+    util::VectorT find_min() { return find_min_impl(initial_point(last_func().dims(), {}), false); }
     util::VectorT find_min(const Function & func)
     {
         set_func(func);
-        return find_min_impl();
+        return find_min();
     }
 
     util::VectorT find_min_traced(const Function & func, util::VectorT init = {})
     {
         set_func(func);
         m_replay_data.clear();
-        return find_min_traced_impl(init.empty() ? util::VectorT(func.dims()) : std::move(init));
+        return find_min_impl(initial_point(func.dims(), std::move(init)), true);
     }
 
     void set_func(const Function & func) { m_last_func = &func; }
+    // Iterations logged by find_min_traced, every one by default
+    void set_trace(util::SampledTrace trace) { m_trace = trace; }
     const Function & last_func() const { return *m_last_func; }
 
     const util::ReplayData & replay_data() const { return m_replay_data; }
+    // Mutable trace, to stream it to file or attach exporter before search
+    util::ReplayData & replay_data() { return m_replay_data; }
+    // Evaluation counters and phase timings of the last search (empty without NEWTONE_INSTRUMENT)
+    const util::SearchStats & stats() const { return m_stats; }
 
 protected:
     static const uint MAX_ITER = 1000;
 protected:
-    virtual util::VectorT find_min_impl() = 0;
-    virtual util::VectorT find_min_traced_impl(util::VectorT init) = 0;
+    /*
+     * Find minimum of the last function starting from "init",
+     * iterations are logged to replay data, if "traced" is set
+     */
+    virtual util::VectorT find_min_impl(util::VectorT init, bool traced) = 0;
+
+    // minimize() doesn't log trace
+    util::VectorT minimize_impl(const Function & func, util::VectorT init) override
+    {
+        set_func(func);
+        return find_min_impl(initial_point(func.dims(), std::move(init)), false);
+    }
 
 protected:
     util::ReplayData m_replay_data;
+    util::SampledTrace m_trace;
+    util::SearchStats m_stats;
     const Function * m_last_func;
 };
 
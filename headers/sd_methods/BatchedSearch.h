@@ -0,0 +1,42 @@
+#pragma once
+
+#include "sd_methods/Function.h"
+#include "sd_methods/MinSearcher.h"
+
+#include <algorithm>
+
+namespace min1d {
+
+/*
+ * Minimization of unimodal function by rounds of simultaneous probes.
+ * Every round evaluates equally spaced points of the current segment together with
+ * minimum of parabola through the best point and its neighbours in one batched call,
+ * the segment shrinks to neighbours of the best point.
+ * With "probes" points the segment shrinks (probes + 1) / 2 times per round,
+ * so far fewer sequential rounds are needed than iterations of Brent's method.
+ */
+struct BatchedSearch : public MinSearcher
+{
+    static constexpr unsigned MaxProbes = 31;
+
+    BatchedSearch(double eps, unsigned probes = 8)
+        : m_eps(eps)
+        , m_probes(std::clamp(probes, 2u, MaxProbes))
+    {}
+
+    std::string_view method_name() const noexcept override { return "Batched search"; }
+
+    void change_parameters(double new_eps) noexcept { m_eps = new_eps; }
+
+    // Number of batched calls made by the last search
+    unsigned rounds() const noexcept { return m_rounds; }
+
+protected:
+    double find_min_impl() noexcept override;
+
+    double m_eps;       // required accuracy
+    unsigned m_probes;  // equally spaced points per round
+    unsigned m_rounds = 0;
+};
+
+} // namespace min1d
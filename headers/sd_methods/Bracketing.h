@@ -0,0 +1,79 @@
+#pragma once
+
+#include "sd_methods/Function.h"
+
+#include "util/Misc.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace min1d {
+
+/*
+ * Bracketing of the minimum along a ray (step >= 0) for line searches.
+ * Initial step is guessed from the previous line search, so that the first order change
+ * of function stays the same: step = prev_step * prev_der / der, then it's expanded
+ * until function starts growing or contracted until function decreases.
+ * Found segment is passed to one-dimensional minimizer instead of a fixed one.
+ */
+struct Bracketing
+{
+    static constexpr double Grow = 2.;          // expansion factor
+    static constexpr double Shrink = 0.25;      // contraction factor
+    static constexpr double MinStep = 1e-12;
+    static constexpr double MaxStep = 1e12;
+    static constexpr double AscentSegment = 10.; // in steps, searched along non-descent direction
+
+    // Forget previous line search, called before new minimization
+    void reset() noexcept { m_prev_step = 0.; }
+
+    /*
+     * Initial step for direction with directional derivative "der",
+     * "default_step" is used for the first line search or when guess is impossible
+     */
+    double initial_step(double der, double default_step) const noexcept;
+
+    /*
+     * Segment containing minimum, the lowest point found inside it
+     * and function's values at the ends (infinity, if unknown)
+     */
+    struct Bracket
+    {
+        Function::Bounds bounds;
+        double x, f_x;
+        double f_from, f_to;
+    };
+
+    /*
+     * Segment containing minimum of "func", "value" and "der" are its value and derivative at 0,
+     * "step" is initial step.
+     * Function doesn't decrease at 0 along non-descent direction, so there is nothing to bracket,
+     * whole segment [0, AscentSegment * step] is returned then.
+     */
+    Bracket bracket(const util::CalculateFunc & func, double value, double der, double step) const;
+
+    // Remember accepted step and directional derivative along its direction
+    void accept(double step, double der) noexcept
+    {
+        m_prev_step = step;
+        m_prev_der = der;
+    }
+    double prev_step() const noexcept { return m_prev_step; }
+    double prev_der() const noexcept { return m_prev_der; }
+
+private:
+    double m_prev_step = 0.;
+    double m_prev_der = 0.;
+};
+
+/*
+ * Tolerance of line search, which follows the outer method's progress:
+ * directional derivative is large far from minimum, there rough step is enough,
+ * close to minimum the required precision "eps" is used
+ */
+inline double line_search_eps(double der, double eps, double max_eps = 1e-3) noexcept
+{
+    return std::clamp(std::abs(der), eps, std::max(eps, max_eps));
+}
+
+} // namespace min1d
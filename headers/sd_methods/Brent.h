@@ -1,11 +1,13 @@
 #pragma once
 
+#include "sd_methods/Bracketing.h"
 #include "sd_methods/Function.h"
 #include "sd_methods/MinSearcher.h"
 
 #include "util/ReplayData.h"
 
 #include <cmath>
+#include <optional>
 
 namespace min1d {
 
@@ -22,6 +24,20 @@ struct Brent : public MinSearcher
 
     void change_parameters(double new_eps) noexcept { m_eps = new_eps; }
 
+    using MinSearcher::find_min;
+    /*
+     * Find minimum on segment found by bracketing,
+     * known values of the lowest point and the ends save evaluations and allow parabolic step at once
+     */
+    double find_min(Function func, const Bracketing::Bracket & bracket)
+    {
+        m_start = bracket;
+        return find_min(std::move(func));
+    }
+
+    // Function's value in minimum found by the last search
+    double min_value() const noexcept { return m_min_value; }
+
 protected:
     /*
      * Find unimodal function's minimum
@@ -30,6 +46,8 @@ protected:
     double find_min_impl() noexcept override;
 
     double m_eps; // required accuracy
+    std::optional<Bracketing::Bracket> m_start;  // known points for the next search
+    double m_min_value = 0.;
 };
 
 } // namespace min1d
@@ -19,6 +19,7 @@ struct Function
 
 public:
     Function(util::CalculateFunc calculate, Bounds bounds, std::string as_string = "");
+    Function(util::CalculateFunc calculate, util::CalculateBatchFunc calculate_batch, Bounds bounds, std::string as_string = "");
 
     void reset(std::string as_string, util::CalculateFunc calculate);
 
@@ -26,6 +27,11 @@ public:
      * Calculate function's value in point x
      */
     double operator()(double x) const { ++m_call_count; return m_calculate(x); }
+    /*
+     * Calculate function's values in "count" points at once,
+     * points are calculated one by one, if there is no batch calculation
+     */
+    void operator()(const double * xs, std::size_t count, double * out) const;
 
     uint call_count() const noexcept { return m_call_count; }
 
@@ -40,8 +46,9 @@ public:
 private:
     std::string m_as_string;
     util::CalculateFunc m_calculate;
+    util::CalculateBatchFunc m_calculate_batch;
     Bounds m_bounds;
-    mutable uint m_call_count;
+    mutable uint m_call_count = 0;
 };
 
 } // namespace min1d
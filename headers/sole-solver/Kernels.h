@@ -0,0 +1,150 @@
+#pragma once
+
+#include "sole-solver/ProfileMatrix.h"
+#include "sole-solver/SparseMatrix.h"
+
+#include <vector>
+
+/*
+ * Kernels over stored elements of ProfileMatrix and SparseMatrix.
+ * They stream diagonal, lower and upper arrays in memory order and never look up single elements,
+ * so their cost is proportional to the number of stored elements.
+ */
+class Kernels
+{
+public:
+    using value_t = double;
+    using id_t = std::size_t;
+
+    /*
+     * Rows in a chunk of the parallel product.
+     * Larger matrices are multiplied by chunks, which are independent of number of threads,
+     * so the result doesn't depend on it.
+     */
+    static constexpr id_t ChunkRows = 4096;
+
+    /*
+     * out = m * vec, "out" is resized to number of rows.
+     * Chunks of large matrices are distributed between "threads" threads, all hardware threads are used if 0.
+     */
+    static void multiply(const ProfileMatrix & m, const std::vector<value_t> & vec, std::vector<value_t> & out, unsigned threads = 0);
+    static void multiply(const SparseMatrix & m, const std::vector<value_t> & vec, std::vector<value_t> & out, unsigned threads = 0);
+
+    /*
+     * Solve L * x = b in place, where L is the lower part of LU-decomposed "lu" with unit diagonal.
+     * Returns number of multiplications.
+     */
+    static id_t forward_substitution(const ProfileMatrix & lu, std::vector<value_t> & b);
+    static id_t forward_substitution(const SparseMatrix & lu, std::vector<value_t> & b);
+
+    /*
+     * Solve U * x = b in place, where U is the diagonal and upper part of LU-decomposed "lu".
+     * Returns number of multiplications and divisions.
+     */
+    static id_t backward_substitution(const ProfileMatrix & lu, std::vector<value_t> & b);
+    static id_t backward_substitution(const SparseMatrix & lu, std::vector<value_t> & b);
+
+    /*
+     * The same substitutions for factors of any precision, stored in separate arrays
+     * in the pattern of "pattern" (ProfileMatrix or SparseMatrix). Right part is in double precision.
+     */
+    template <class M, class T>
+    static id_t forward_substitution(const M & pattern, const T * low, std::vector<value_t> & b);
+    template <class M, class T>
+    static id_t backward_substitution(const M & pattern, const T * diag, const T * up, std::vector<value_t> & b);
+
+    /*
+     * The same substitutions for a block of "count" right parts: block[i * count + k] is the i-th element
+     * of the k-th right part. Every element of factors is read once for all right parts and the inner loops
+     * run over contiguous right parts. Every right part gets the same result as by the single substitution.
+     * Returns number of multiplications and divisions for all right parts.
+     */
+    template <class M, class T>
+    static id_t forward_substitution(const M & pattern, const T * low, value_t * block, id_t count);
+    template <class M, class T>
+    static id_t backward_substitution(const M & pattern, const T * diag, const T * up, value_t * block, id_t count);
+};
+
+// L is traversed by rows
+template <class M, class T>
+auto Kernels::forward_substitution(const M & pattern, const T * low, std::vector<value_t> & b) -> id_t
+{
+    id_t actions_cnt = 0;
+    for (id_t i = 0; i < b.size(); i++)
+    {
+        const id_t begin = pattern.row_begin(i), end = pattern.row_end(i);
+        for (id_t p = begin; p < end; p++)
+        {
+            b[i] -= b[pattern.col_of(i, p)] * low[p];
+        }
+        actions_cnt += end - begin;
+    }
+    return actions_cnt;
+}
+
+// U is traversed by columns, which are rows of the upper storage
+template <class M, class T>
+auto Kernels::backward_substitution(const M & pattern, const T * diag, const T * up, std::vector<value_t> & b) -> id_t
+{
+    id_t actions_cnt = 0;
+    for (id_t i = b.size(); i-- > 0;)
+    {
+        b[i] /= diag[i];
+        const id_t begin = pattern.row_begin(i), end = pattern.row_end(i);
+        for (id_t p = begin; p < end; p++)
+        {
+            b[pattern.col_of(i, p)] -= up[p] * b[i];
+        }
+        actions_cnt += end - begin + 1;
+    }
+    return actions_cnt;
+}
+
+template <class M, class T>
+auto Kernels::forward_substitution(const M & pattern, const T * low, value_t * block, id_t count) -> id_t
+{
+    id_t actions_cnt = 0;
+    for (id_t i = 0; i < pattern.row_cnt(); i++)
+    {
+        value_t * row = block + i * count;
+        const id_t begin = pattern.row_begin(i), end = pattern.row_end(i);
+        for (id_t p = begin; p < end; p++)
+        {
+            const value_t * known = block + pattern.col_of(i, p) * count;
+            const T l = low[p];
+            for (id_t k = 0; k < count; k++)
+            {
+                row[k] -= known[k] * l;
+            }
+        }
+        actions_cnt += (end - begin) * count;
+    }
+    return actions_cnt;
+}
+
+template <class M, class T>
+auto Kernels::backward_substitution(const M & pattern, const T * diag, const T * up, value_t * block, id_t count) -> id_t
+{
+    id_t actions_cnt = 0;
+    for (id_t i = pattern.row_cnt(); i-- > 0;)
+    {
+        value_t * row = block + i * count;
+        const T d = diag[i];
+        for (id_t k = 0; k < count; k++)
+        {
+            row[k] /= d;
+        }
+        const id_t begin = pattern.row_begin(i), end = pattern.row_end(i);
+        for (id_t p = begin; p < end; p++)
+        {
+            value_t * changed = block + pattern.col_of(i, p) * count;
+            const T u = up[p];
+            for (id_t k = 0; k < count; k++)
+            {
+                changed[k] -= u * row[k];
+            }
+        }
+        actions_cnt += (end - begin + 1) * count;
+    }
+    return actions_cnt;
+}
@@ -28,4 +28,11 @@ public:
     virtual id_t col_cnt() const = 0;
 
     std::vector<value_t> operator*(const std::vector<value_t>& vec) const;
+
+protected:
+    /*
+     * Writes matrix * "vec" to "out" of row_cnt() size.
+     * Default implementation visits every cell with get(), storages override it to visit only stored elements.
+     */
+    virtual void multiply_into(const std::vector<value_t>& vec, std::vector<value_t>& out) const;
 };
\ No newline at end of file
@@ -1,12 +1,13 @@
 #pragma once
 #include "sole-solver/Matrix.h"
 
+#include <cassert>
 #include <vector>
 #include <iostream>
 /*
  * Class, representing two-dimensional matrix contained without any optimizations
  */
-class QuadMatrix : public Matrix
+class QuadMatrix final : public Matrix
 {
     using value_vec = std::vector<value_t>;
 public:
@@ -31,19 +32,38 @@ public:
     /*
      *Returns value from "row" rowand "col" column.
      */
-    value_t get(id_t row, id_t col) const override;
+    value_t get(id_t row, id_t col) const override
+    {
+        assert(row >= 0 && col >= 0 && row < matrix.size() && (!matrix.size() || col < matrix.front().size())
+            && "Indexes out of bounds in QuadMatrix get");
+        return matrix[row][col];
+    }
 
     /*
      * Sets value "val" to "row" row and "col" column.
      */
-    void set(id_t row, id_t col, value_t val) override;
+    void set(id_t row, id_t col, value_t val) override
+    {
+        assert(row >= 0 && col >= 0 && row < matrix.size() && (!matrix.size() || col < matrix.front().size())
+            && "Indexes out of bounds in QuadMatrix set");
+        matrix[row][col] = val;
+    }
 
     id_t row_cnt() const override { return matrix.size(); }
     id_t col_cnt() const override { return matrix.size(); }
 
+    /*
+     * Returns number of bytes used to store elements and indexes of the matrix.
+     */
+    std::size_t footprint() const;
+
     const std::vector<value_vec> & get_matrix() const;
+    std::vector<value_vec> & get_matrix() { return matrix; }
 
     friend std::ostream& operator<<(std::ostream& os, const QuadMatrix& qm);
+protected:
+    void multiply_into(const value_vec& vec, value_vec& out) const override;
+
 private:
     std::vector<value_vec> matrix; // two-dimensional vector, containing the matrix
 };
\ No newline at end of file
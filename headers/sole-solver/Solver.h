@@ -1,7 +1,11 @@
 #pragma once
 
 #include "sole-solver/Matrix.h"
+#include "sole-solver/ProfileMatrix.h"
+#include "sole-solver/QuadMatrix.h"
+#include "sole-solver/SparseMatrix.h"
 
+#include <variant>
 #include <vector>
 
 class Solver
@@ -20,12 +24,68 @@ public:
 
         std::vector<value_t> answer;
         id_t actions;
+        id_t refinements = 0;                                       // steps of iterative refinement
+        bool double_fallback = false;                               // refinement didn't converge, factorized in double precision
     };
 
+    // Limit of refinement steps of solve_lu_refined
+    static constexpr id_t MaxRefinements = 30;
+
+    /*
+     * LU-decomposition of a matrix, which solves systems with any number of right parts
+     * without decomposing the matrix again
+     */
+    class Factorization
+    {
+    public:
+        /*
+         * Decomposed matrix in its own storage: L (with unit diagonal) in the lower part, U in the diagonal and upper part.
+         * Matrices of other storages are decomposed to ProfileMatrix.
+         */
+        using Storage = std::variant<QuadMatrix, ProfileMatrix, SparseMatrix>;
+
+        id_t dims() const;
+
+        /*
+         * Solve a * x = b, for QuadMatrix, ProfileMatrix and SparseMatrix the answer is the same as solve_lu gives
+         */
+        Result solve(std::vector<value_t> b) const;
+
+        /*
+         * Solve a * x = b for "count" right parts at once: rhs[i * count + k] is the i-th element of the k-th right part,
+         * answers are written to "rhs" in the same layout.
+         * Every element of factors is read once for all right parts, answers are the same as by single solves.
+         * Returns number of multiplications and divisions.
+         */
+        id_t solve(std::vector<value_t> & rhs, id_t count) const;
+
+    private:
+        friend class Solver;
+
+        explicit Factorization(Storage lu)
+            : m_lu(std::move(lu))
+        {}
+
+    private:
+        Storage m_lu;
+    };
+
+    /*
+     * Decompose a matrix for solving systems with several right parts, see Factorization
+     */
+    static Factorization factorize_lu(Matrix && a);
+
     /*
      * Solve a system of linear equations using Gauss with LU-decomposition method
      */
     static Result solve_lu(Matrix && a, std::vector<value_t> && b);
+    /*
+     * Solve a system of linear equations using LU-decomposition in single precision,
+     * which is refined to double precision accuracy with residuals counted in double precision.
+     * Falls back to solve_lu, if refinement doesn't converge.
+     * Matrices of unknown storages are solved by solve_lu.
+     */
+    static Result solve_lu_refined(Matrix && a, std::vector<value_t> && b);
     /*
      * Solve a system of linear equations using Gauss with pivot element choice
      */
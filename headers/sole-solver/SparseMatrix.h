@@ -2,10 +2,12 @@
 
 #include "sole-solver/Matrix.h"
 
+#include <cassert>
 #include <iostream>
+#include <utility>
 #include <vector>
 
-class SparseMatrix : public Matrix
+class SparseMatrix final : public Matrix
 {
     using value_vec = std::vector<value_t>;
     using id_vec = std::vector<id_t>;
@@ -39,22 +41,84 @@ public:
      * If the required cell is contained, than the corresponding value is returned.
      * Otherwise, returns 0.
      */
-    value_t get(id_t row, id_t col) const override;
+    value_t get(id_t row, id_t col) const override
+    {
+        auto res = get_ptr(row, col);
+        return res ? *res : 0;
+    }
 
     /*
      * Sets value "val" to "row" row and "col" column.
      * If the required cell is contained, than the corresponding value is set.
      * Otherwise, does nothing.
      */
-    void set(id_t row, id_t col, value_t val) override;
+    void set(id_t row, id_t col, value_t val) override
+    {
+        auto changed = get_ptr(row, col);
+        if (changed) {
+            *changed = val;
+        }
+    }
 
     id_t row_cnt() const override { return diag.size(); }
     id_t col_cnt() const override { return diag.size(); }
 
+    /*
+     * Returns number of bytes used to store elements and indexes of the matrix.
+     */
+    std::size_t footprint() const;
+
+    /*
+     * Stored elements of the lower part of "row" and, symmetrically, of the upper part of "row" column
+     * are at positions [row_begin(row), row_end(row)) of lower() and upper(), in increasing order of columns.
+     * Algorithms over these positions visit only stored elements in memory order.
+     */
+    id_t row_begin(id_t row) const { return i_prof[row] - 1; }
+    id_t row_end(id_t row) const { return i_prof[row + 1] - 1; }
+    id_t col_of(id_t /*row*/, id_t pos) const { return j_prof[pos]; }
+
+    const value_t * diagonal() const { return diag.data(); }
+    value_t * diagonal() { return diag.data(); }
+    const value_t * lower() const { return a_low.data(); }
+    value_t * lower() { return a_low.data(); }
+    const value_t * upper() const { return a_up.data(); }
+    value_t * upper() { return a_up.data(); }
+
     friend std::ostream& operator<<(std::ostream& os, const SparseMatrix& pm);
+protected:
+    void multiply_into(const value_vec& vec, value_vec& out) const override;
+
 private:
-    const value_t* get_ptr(id_t row, id_t col) const;
-    value_t* get_ptr(id_t row, id_t col);
+    const value_t* get_ptr(id_t row, id_t col) const
+    {
+        assert(row >= 0 && col >= 0
+               && row < diag.size() && col < diag.size()
+               && "Row and column indexes must be in bounds to get");
+
+        if (row == col)
+        { return &diag[row]; }
+
+        bool is_lower = col < row;
+        if (!is_lower)
+        {
+            std::swap(col, row);
+        }
+
+        id_t start_pos = row_begin(row), end_pos = row_end(row);
+        for (id_t i = start_pos; i < end_pos; i++)
+        {
+            if (j_prof[i] == col)
+            {
+                return is_lower ? &a_low[i] : &a_up[i];
+            }
+        }
+        return nullptr;
+    }
+
+    value_t* get_ptr(id_t row, id_t col)
+    {
+        return const_cast<value_t*>(const_cast<const SparseMatrix*>(this)->get_ptr(row, col));
+    }
 
 private:
     value_vec diag;                                                 // vector, containing diagonal elements
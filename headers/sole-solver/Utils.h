@@ -85,53 +85,71 @@ struct Generator
         create_test(dir, testname, std::move(generate_quad_matrix(dim, width)), std::move(generate_vector(dim)));
     }
 
+    /*
+     * Generates a matrix with diagonal dominance, which condition number grows with "k":
+     * off-diagonal elements are random integers from [-4, 0], diagonal ones are negated sums of the row,
+     * and the first diagonal element is increased by 10^-k.
+     * Non-zero elements are placed closer than "width" to the main diagonal.
+     */
+    static QuadMatrix generate_cond_matrix(const std::size_t dim, const int k, const std::size_t width = UINT_MAX)
+    {
+        return generate_test_quad_matrix(dim, [k, width](std::vector<std::vector<double>>& matrix)
+                                         {
+                                             const std::size_t dim = matrix.size();
+                                             std::uniform_int_distribution<int> dist(-4, 0);
+                                             for (int i = 0; i < dim; i++)
+                                             {
+                                                 double sum = 0;
+                                                 for (int j = 0; j < dim; j++)
+                                                 {
+                                                     if (i != j && std::abs(i - j) <= width)
+                                                     {
+                                                         sum += matrix[i][j] = dist(Generator::rand_gen);
+                                                     }
+                                                 }
+                                                 matrix[i][i] = -sum;
+                                                 if (!i)
+                                                     matrix[i][i] += std::pow(10., -k);
+                                             }
+                                         });
+    }
+
+    /*
+     * Generates a Hilbert matrix, cut to elements closer than "width" to the main diagonal.
+     * Note, that as we have zero-numeration we have to use changed formula: (i + j - 1) -> ((i + 1) + (j + 1) - 1) = (i + j + 1)
+     */
+    static QuadMatrix generate_gilbert_matrix(const std::size_t dim, const std::size_t width = UINT_MAX)
+    {
+        return generate_test_quad_matrix(dim, [width](std::vector<std::vector<double>>& matrix)
+                                         {
+                                             const std::size_t dim = matrix.size();
+                                             for (int i = 0; i < dim; i++)
+                                             {
+                                                 for (int j = 0; j < dim; j++)
+                                                 {
+                                                     if (std::abs(i - j) <= width)
+                                                     {
+                                                         matrix[i][j] = 1. / (i + j + 1.);
+                                                     }
+                                                 }
+                                             }
+                                         });
+    }
+
     /*
      * Create a test (matrix, answer vector, right part vector) for the fourth task and writes to given directory with given k prefix
      */
     static void create_quad_cond_test(const std::string& dir, const int& k, const std::size_t& dim, const std::size_t& width = UINT_MAX)
     {
-        create_test(dir, std::to_string(k),
-                    std::move(generate_test_quad_matrix(dim, [k, width](std::vector<std::vector<double>>& matrix)
-                                                           {
-                                                               const std::size_t dim = matrix.size();
-                                                               std::uniform_int_distribution<int> dist(-4, 0);
-                                                               for (int i = 0; i < dim; i++)
-                                                               {
-                                                                   double sum = 0;
-                                                                   for (int j = 0; j < dim; j++)
-                                                                   {
-                                                                       if (i != j)
-                                                                       {
-                                                                           sum += matrix[i][j] = dist(Generator::rand_gen);
-                                                                       }
-                                                                   }
-                                                                   matrix[i][i] = -sum;
-                                                                   if (!i)
-                                                                       matrix[i][i] += std::pow(10., -k);
-                                                               }
-                                                           })),
-                    std::move(generate_vector(dim)));
+        create_test(dir, std::to_string(k), generate_cond_matrix(dim, k, width), std::move(generate_vector(dim)));
     }
 
     /*
      * Create a test (matrix, answer vector, right part vector) for the fourth task and writes to given directory with given k prefix
-     * Note, that as we have zero-numeration we have to use changed formula: (i + j - 1) -> ((i + 1) + (j + 1) - 1) = (i + j + 1)
      */
     static void create_quad_gilbert_test(const std::string& dir, const std::size_t& dim, const std::size_t& width = UINT_MAX)
     {
-        create_test(dir, std::to_string(dim),
-                    std::move(generate_test_quad_matrix(dim, [width](std::vector<std::vector<double>>& matrix)
-                                                           {
-                                                               const std::size_t dim = matrix.size();
-                                                               for (int i = 0; i < dim; i++)
-                                                               {
-                                                                   for (int j = 0; j < dim; j++)
-                                                                   {
-                                                                        matrix[i][j] = 1. / (i + j + 1.);
-                                                                   }
-                                                               }
-                                                           })),
-                    std::move(generate_vector(dim)));
+        create_test(dir, std::to_string(dim), generate_gilbert_matrix(dim, width), std::move(generate_vector(dim)));
     }
 
     /*------------------------------------PROFILE MATRIX------------------------------------*/
@@ -205,51 +223,15 @@ struct Generator
      */
     static void create_profile_cond_test(const std::string& dir, const int& k, const std::size_t& dim, const std::size_t& width = UINT_MAX)
     {
-        create_test(dir, std::to_string(k),
-                    std::move(generate_test_profile_matrix(dim, [k, width](std::vector<std::vector<double>>& matrix)
-                                                           {
-                                                               const std::size_t dim = matrix.size();
-                                                               std::uniform_int_distribution<int> dist(-4, 0);
-                                                               for (int i = 0; i < dim; i++)
-                                                               {
-                                                                   double sum = 0;
-                                                                   for (int j = 0; j < dim; j++)
-                                                                   {
-                                                                       if (i != j && std::abs(i - j) <= width)
-                                                                       {
-                                                                           sum += matrix[i][j] = dist(Generator::rand_gen);
-                                                                       }
-                                                                   }
-                                                                   matrix[i][i] = -sum;
-                                                                   if (!i)
-                                                                       matrix[i][i] += std::pow(10., -k);
-                                                               }
-                                                           })),
-                    std::move(generate_vector(dim)));
+        create_test(dir, std::to_string(k), ProfileMatrix(generate_cond_matrix(dim, k, width)), std::move(generate_vector(dim)));
     }
 
     /*
      * Create a test (matrix, answer vector, right part vector) for the third task and writes to given directory with given k prefix
-     * Note, that as we have zero-numeration we have to use changed formula: (i + j - 1) -> ((i + 1) + (j + 1) - 1) = (i + j + 1)
      */
     static void create_profile_gilbert_test(const std::string& dir, const std::size_t& dim, const std::size_t& width = UINT_MAX)
     {
-        create_test(dir, std::to_string(dim), 
-                    std::move(generate_test_profile_matrix(dim, [width](std::vector<std::vector<double>>& matrix)
-                                                           {
-                                                               const std::size_t dim = matrix.size();
-                                                               for (int i = 0; i < dim; i++)
-                                                               {
-                                                                   for (int j = 0; j < dim; j++)
-                                                                   {
-                                                                       if (std::abs(i - j) <= width)
-                                                                       {
-                                                                           matrix[i][j] = 1. / (i + j + 1.);
-                                                                       }
-                                                                   }
-                                                               }
-                                                           })),
-                    std::move(generate_vector(dim)));
+        create_test(dir, std::to_string(dim), ProfileMatrix(generate_gilbert_matrix(dim, width)), std::move(generate_vector(dim)));
     }
 
     /*-----------------------------------MISCELLANEOUS-----------------------------------*/
@@ -334,17 +316,6 @@ private:
         return QuadMatrix(m);
     }
 
-    /*
-     * Generate a profile matrix with the given filling rule
-     */
-    template <class Rule>
-    static ProfileMatrix generate_test_profile_matrix(const std::size_t& dim, Rule rule = Rule())
-    {
-        std::vector<std::vector<double>> m(dim, std::vector<double>(dim, 0.));
-        rule(m);
-        return ProfileMatrix(QuadMatrix(m));
-    }
-
     /*
      * Helper for creating and writing test files
      */
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace util {
+
+/*
+ * Bump allocator.
+ * Memory is taken from big blocks in allocation order (so objects built together lie together)
+ * and is freed in one shot, when arena is destroyed.
+ */
+struct Arena
+{
+    static constexpr std::size_t DefaultBlockSize = 64 * 1024;
+
+    explicit Arena(std::size_t block_size = DefaultBlockSize)
+        : m_block_size(block_size)
+    {}
+
+    Arena(const Arena &) = delete;
+    Arena & operator=(const Arena &) = delete;
+
+    void * allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+
+    std::size_t allocated() const noexcept { return m_allocated; }
+    std::size_t block_cnt() const noexcept { return m_blocks.size(); }
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+    std::byte * m_curr = nullptr;   // first free byte in the last block
+    std::size_t m_left = 0;         // free bytes left in the last block
+    std::size_t m_block_size;
+    std::size_t m_allocated = 0;    // total bytes given out
+};
+
+} // namespace util
@@ -0,0 +1,206 @@
+/*
+ *  Vector and matrix operations for small dimensions known at compile time.
+ *  Values are stored in std::array on stack and loops have constant bounds, which compiler unrolls,
+ *  so there are no allocations and no virtual calls. Order of arithmetic operations is the same
+ *  as in the generic code, so results are the same too.
+ */
+#pragma once
+
+#include "util/VectorOps.h"
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+
+namespace util::fixed {
+
+// Largest dimension, which has fixed-size specializations
+inline constexpr unsigned MaxDims = 4;
+
+template <unsigned N>
+using Vec = std::array<double, N>;
+// Square matrix, row-major
+template <unsigned N>
+using Mat = std::array<double, N * N>;
+
+template <unsigned N>
+Vec<N> to_vec(const double * values) noexcept
+{
+    Vec<N> res;
+    for (unsigned i = 0; i < N; ++i) {
+        res[i] = values[i];
+    }
+    return res;
+}
+
+template <unsigned N>
+Vec<N> to_vec(const VectorT & vec) noexcept { return to_vec<N>(vec.data()); }
+
+template <unsigned N>
+Mat<N> to_mat(const double * values) noexcept
+{
+    Mat<N> res;
+    for (unsigned i = 0; i < N * N; ++i) {
+        res[i] = values[i];
+    }
+    return res;
+}
+
+template <unsigned N>
+Mat<N> to_mat(const MatrixT & mtx) noexcept
+{
+    Mat<N> res;
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned j = 0; j < N; ++j) {
+            res[i * N + j] = mtx[i][j];
+        }
+    }
+    return res;
+}
+
+// Copy back to storage of the same size, doesn't allocate
+template <unsigned N>
+void store(const Vec<N> & vec, VectorT & out) noexcept
+{
+    for (unsigned i = 0; i < N; ++i) {
+        out[i] = vec[i];
+    }
+}
+
+template <unsigned N>
+void store(const Mat<N> & mtx, MatrixT & out) noexcept
+{
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned j = 0; j < N; ++j) {
+            out[i][j] = mtx[i * N + j];
+        }
+    }
+}
+
+template <unsigned N>
+double scalar(const Vec<N> & lhs, const Vec<N> & rhs) noexcept
+{
+    double res = 0.;
+    for (unsigned i = 0; i < N; ++i) {
+        res += lhs[i] * rhs[i];
+    }
+    return res;
+}
+
+// Squared length, as util::length
+template <unsigned N>
+double length(const Vec<N> & vec) noexcept { return scalar<N>(vec, vec); }
+
+template <unsigned N>
+Vec<N> mul(const Mat<N> & mtx, const Vec<N> & vec) noexcept
+{
+    Vec<N> res;
+    for (unsigned i = 0; i < N; ++i) {
+        double sum = 0.;
+        for (unsigned j = 0; j < N; ++j) {
+            sum += mtx[i * N + j] * vec[j];
+        }
+        res[i] = sum;
+    }
+    return res;
+}
+
+/*
+ * Solve a * x = b with LU-decomposition, as Solver::solve_lu does, answer is written to "b".
+ * Matrix is decomposed in place: L (with unit diagonal) below diagonal, U on and above it.
+ */
+template <unsigned N>
+void solve_lu(Mat<N> a, Vec<N> & b) noexcept
+{
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned j = 0; j < N; ++j) {
+            double cell = a[i * N + j];
+            for (unsigned k = 0; k < std::min(i, j); ++k) {
+                cell -= a[i * N + k] * a[k * N + j];
+            }
+            if (i > j) {
+                cell /= a[j * N + j];
+            }
+            a[i * N + j] = cell;
+        }
+    }
+
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned j = i + 1; j < N; ++j) {
+            b[j] -= b[i] * a[j * N + i];
+        }
+    }
+    for (unsigned i = N; i-- > 0;) {
+        for (unsigned j = i + 1; j < N; ++j) {
+            b[i] -= a[i * N + j] * b[j];
+        }
+        b[i] /= a[i * N + i];
+    }
+}
+
+/*
+ * Broyden-Fletcher-Shanno update of anti-hessian "ah" by difference of antigradients "w_diff"
+ * and difference of points "x_diff", see BasicQuasiNewton::bfs
+ */
+template <unsigned N>
+void bfs_update(Mat<N> & ah, const Vec<N> & w_diff, const Vec<N> & x_diff) noexcept
+{
+    Vec<N> ah_wd = mul<N>(ah, w_diff);
+    double roe = scalar<N>(ah_wd, w_diff);
+    double wd_cd = scalar<N>(w_diff, x_diff);
+    double inv_roe = 1. / roe;
+    double inv_wd_cd = 1. / wd_cd;
+
+    Vec<N> r;
+    for (unsigned i = 0; i < N; ++i) {
+        r[i] = ah_wd[i] * inv_roe - x_diff[i] * inv_wd_cd;
+    }
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned j = 0; j < N; ++j) {
+            double & cell = ah[i * N + j];
+            cell -= x_diff[j] * x_diff[i] * inv_wd_cd;
+            cell -= ah_wd[j] * ah_wd[i] * inv_roe;
+            cell += r[j] * r[i] * roe;
+        }
+    }
+}
+
+// Powell update of anti-hessian, see BasicQuasiNewton::powell
+template <unsigned N>
+void powell_update(Mat<N> & ah, const Vec<N> & w_diff, const Vec<N> & x_diff) noexcept
+{
+    Vec<N> x_wave = mul<N>(ah, w_diff);
+    for (unsigned i = 0; i < N; ++i) {
+        x_wave[i] += x_diff[i];
+    }
+    double inv = 1. / scalar<N>(w_diff, x_wave);
+
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned j = 0; j < N; ++j) {
+            ah[i * N + j] -= x_wave[j] * x_wave[i] * inv;
+        }
+    }
+}
+
+namespace detail {
+
+template <class Callback, unsigned... Ns>
+bool dispatch(unsigned dims, Callback & func, std::integer_sequence<unsigned, Ns...>)
+{
+    return ((dims == Ns + 1 ? (func(std::integral_constant<unsigned, Ns + 1>{}), true) : false) || ...);
+}
+
+} // namespace detail
+
+/*
+ * Calls func(std::integral_constant<unsigned, N>{}) with N == dims, if dims <= MaxDims.
+ * Returns false, if there is no specialization for "dims".
+ */
+template <class Callback>
+bool dispatch(unsigned dims, Callback && func)
+{
+    return detail::dispatch(dims, func, std::make_integer_sequence<unsigned, MaxDims>{});
+}
+
+} // namespace util::fixed
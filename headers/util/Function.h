@@ -1,10 +1,14 @@
 #pragma once
 
+#include "sole-solver/Matrix.h"
+#include "util/Arena.h"
+#include "util/SimdKernels.h"
 #include "util/VectorOps.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <functional>
 #include <iterator>
 #include <ostream>
@@ -14,6 +18,8 @@
 #include <utility>
 #include <vector>
 
+struct SimplifyStats;
+
 template <unsigned Depth>
 struct Func
 {
@@ -34,18 +40,80 @@ struct Func
         return res;
     }
 
-    GradRes grad() const
+    /*
+     * Evaluate into caller-owned contiguous buffer without allocations.
+     * For Depth > 1 values are written in row-major order.
+     * Returns pointer past the last written value.
+     */
+    double * eval_into(const util::VectorT & x, double * out) const
+    {
+        for (const auto & func : m_funcs) {
+            if constexpr (Depth == 1) {
+                *out++ = deref(func)(x);
+            } else {
+                out = deref(func).eval_into(x, out);
+            }
+        }
+        return out;
+    }
+
+    /*
+     * Evaluate gradient-like function into vector, reusing its storage.
+     */
+    template <unsigned D = Depth>
+    std::enable_if_t<D == 1> eval_into(const util::VectorT & x, util::VectorT & out) const
+    {
+        out.resize(dims());
+        eval_into(x, out.data());
+    }
+
+    /*
+     * Evaluate hessian-like function directly into matrix.
+     * Values outside of matrix storage (e.g. profile) are dropped by Matrix::set.
+     */
+    template <unsigned D = Depth>
+    std::enable_if_t<D == 2> eval_into(const util::VectorT & x, Matrix & out) const
+    {
+        for (unsigned row = 0; row < dims(); ++row) {
+            const auto & line = (*this)[row];
+            for (unsigned col = 0; col < line.dims(); ++col) {
+                out.set(row, col, line[col](x));
+            }
+        }
+    }
+
+    /*
+     * Evaluate in "count" points at once (see Func<0>::eval_batch for points' layout).
+     * Component i of the result for point k is written to out[i * count + k].
+     * Returns pointer past the last written value.
+     */
+    double * eval_batch(const double * xs, std::size_t count, double * out) const
+    {
+        for (const auto & func : m_funcs) {
+            if constexpr (Depth == 1) {
+                deref(func).eval_batch(xs, count, out);
+                out += count;
+            } else {
+                out = deref(func).eval_batch(xs, count, out);
+            }
+        }
+        return out;
+    }
+
+    GradRes grad(SimplifyStats * stats = nullptr) const
     {
         std::vector<Func<Depth>> res;
         res.reserve(dims());
         for (const auto & func : m_funcs) {
-            res.emplace_back(deref(func).grad());
+            res.emplace_back(deref(func).grad(stats));
         }
         return GradRes(std::move(res));
     }
 
     unsigned dims() const noexcept { return m_funcs.size(); }
 
+    const Func<Depth - 1> & operator[](unsigned idx) const noexcept { return deref(m_funcs[idx]); }
+
     friend std::ostream & operator<<(std::ostream & out, const Func<Depth> & f) {
         out << "[\n";
         for (const auto & func : f.m_funcs) {
@@ -68,6 +136,45 @@ private:
     Underlying m_funcs;
 };
 
+/*
+ * Kinds of expression nodes, see Func<0>::call_func
+ */
+enum struct FnKind
+{
+    Const,
+    Variable,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Sum,
+    Product,
+    Pow,
+    RealPow,
+    Exp,
+    Log,
+    Sqrt,
+    Sin,
+    Cos,
+    Custom,     // user-defined node, opaque for tree passes
+};
+
+struct Const;
+struct Variable;
+struct Add;
+struct Sub;
+struct Mul;
+struct Div;
+struct Sum;
+struct Product;
+struct Pow;
+struct RealPow;
+struct Exp;
+struct Log;
+struct Sqrt;
+struct Sin;
+struct Cos;
+
 template<>
 struct Func<0>
 {
@@ -81,25 +188,83 @@ protected:
 public:
     virtual ~Func() = default;
 
+    /*
+     * Nodes are allocated from the arena of current ArenaScope, if there is one,
+     * otherwise from the heap. Arena nodes' memory is freed with the arena itself,
+     * so the arena must outlive all the nodes allocated from it.
+     */
+    static void * operator new(std::size_t size);
+    static void operator delete(void * ptr) noexcept;
+
+    /*
+     * While alive, makes all nodes built in the current thread be allocated from "arena".
+     */
+    struct ArenaScope
+    {
+        explicit ArenaScope(util::Arena & arena);
+        ~ArenaScope();
+
+        ArenaScope(const ArenaScope &) = delete;
+        ArenaScope & operator=(const ArenaScope &) = delete;
+
+    private:
+        util::Arena * m_prev;
+    };
+
 public:
     virtual double operator()(const util::VectorT & x) const noexcept = 0;
     virtual std::unique_ptr<Func> part_der(unsigned idx) const noexcept = 0;
     virtual std::unique_ptr<Func> clone() const noexcept = 0;
     virtual std::ostream & print(std::ostream & out) const = 0;
 
+    /*
+     * Evaluate function in "count" points at once.
+     * Points are stored coordinate-major (structure of arrays):
+     * xs[i * count + k] is the i-th coordinate of the k-th point.
+     * Built-in nodes evaluate whole batch with vectorizable loops,
+     * default implementation evaluates points one by one.
+     */
+    virtual void eval_batch(const double * xs, std::size_t count, double * out) const noexcept;
+
+    /*
+     * Value of function and its derivative along direction "dir", counted in one pass.
+     * Default implementation uses finite difference.
+     */
+    struct Dual
+    {
+        double value;
+        double der;
+    };
+    virtual Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept;
+
+    /*
+     * Tree structure, used by passes over expressions
+     */
+    virtual FnKind kind() const noexcept { return FnKind::Custom; }
+    virtual unsigned child_cnt() const noexcept { return 0; }
+    virtual const Func & child(unsigned idx) const noexcept;
+    // Move children out of the node, leaving it unusable
+    virtual std::vector<std::unique_ptr<Func>> take_children() noexcept { return {}; }
+    // Build the same operation over other children
+    virtual std::unique_ptr<Func> with_children(std::vector<std::unique_ptr<Func>> /*children*/) const noexcept { return clone(); }
+
+    /*
+     * Call "visitor" with node casted to its actual type ("const Fn &" for custom nodes)
+     */
+    template <class Visitor>
+    auto call_func(Visitor && visitor) const;
+
     friend std::ostream & operator<<(std::ostream & out, const Func<0> & fn) { return fn.print(out); }
 
     unsigned dims() const noexcept { return m_dims; }
 
-    Func<1> grad() const noexcept
-    {
-        std::vector<std::unique_ptr<Func<0>>> derivs(dims());
-        for (unsigned i = 0; i < dims(); ++i) {
-            derivs[i] = part_der(i);
-            derivs[i]->m_dims = dims();
-        }
-        return Func<1>(std::move(derivs));
-    }
+    /*
+     * Gradient: partial derivatives, passed through optimize_powers and simplify.
+     * If "stats" is given, simplification's node counts are added to it.
+     */
+    Func<1> grad(SimplifyStats * stats = nullptr) const noexcept;
+    // The same by the first "vars" variables only, the others are treated as parameters
+    Func<1> partial_grad(unsigned vars, SimplifyStats * stats = nullptr) const noexcept;
 
     double as_const() const noexcept
     {
@@ -119,7 +284,16 @@ std::unique_ptr<Fn> var(unsigned idx);
 std::unique_ptr<Fn> add(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r);
 std::unique_ptr<Fn> sub(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r);
 std::unique_ptr<Fn> mul(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r);
+std::unique_ptr<Fn> div(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r);
+std::unique_ptr<Fn> sum(std::vector<std::unique_ptr<Fn>> terms, std::vector<double> coefs, double constant = 0.);
+std::unique_ptr<Fn> product(std::vector<std::unique_ptr<Fn>> factors, double coef = 1.);
 std::unique_ptr<Fn> pow(std::unique_ptr<Fn> base, int p);
+std::unique_ptr<Fn> pow(std::unique_ptr<Fn> base, double p);
+std::unique_ptr<Fn> exp(std::unique_ptr<Fn> arg);
+std::unique_ptr<Fn> log(std::unique_ptr<Fn> arg);
+std::unique_ptr<Fn> sqrt(std::unique_ptr<Fn> arg);
+std::unique_ptr<Fn> sin(std::unique_ptr<Fn> arg);
+std::unique_ptr<Fn> cos(std::unique_ptr<Fn> arg);
 
 inline std::unique_ptr<Fn> operator*(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r) { return mul(std::move(l), std::move(r)); }
 inline std::unique_ptr<Fn> operator*(std::unique_ptr<Fn> l, double r) { return std::move(l) * cns(r); }
@@ -134,8 +308,11 @@ inline std::unique_ptr<Fn> operator-(std::unique_ptr<Fn> l, double r) { return s
 inline std::unique_ptr<Fn> operator-(double l, std::unique_ptr<Fn> r) { return cns(l) - std::move(r); }
 
 inline std::unique_ptr<Fn> operator^(std::unique_ptr<Fn> l, int r) { return pow(std::move(l), r); }
+inline std::unique_ptr<Fn> operator^(std::unique_ptr<Fn> l, double r) { return pow(std::move(l), r); }
 
-inline std::unique_ptr<Fn> operator/(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r) { return mul(std::move(l), pow(std::move(r), -1)); }
+inline std::unique_ptr<Fn> operator/(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r) { return div(std::move(l), std::move(r)); }
+inline std::unique_ptr<Fn> operator/(std::unique_ptr<Fn> l, double r) { return std::move(l) / cns(r); }
+inline std::unique_ptr<Fn> operator/(double l, std::unique_ptr<Fn> r) { return cns(l) / std::move(r); }
 
 struct Variable : Fn
 {
@@ -145,6 +322,9 @@ struct Variable : Fn
     {}
 
     double operator()(const util::VectorT & x) const noexcept override { return x[index]; }
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override { std::copy_n(xs + index * count, count, out); }
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override { return {x[index], dir[index]}; }
+    FnKind kind() const noexcept override { return FnKind::Variable; }
     std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
     std::unique_ptr<Fn> clone() const noexcept override { return std::make_unique<Variable>(index); }
     std::ostream & print(std::ostream & out) const override { return out << "x" << index; }
@@ -159,7 +339,10 @@ struct Const : Fn
         , value(val)
     {}
 
-    double operator()(const util::VectorT & x) const noexcept override { return value; }
+    double operator()(const util::VectorT & /*x*/) const noexcept override { return value; }
+    void eval_batch(const double * /*xs*/, std::size_t count, double * out) const noexcept override { std::fill_n(out, count, value); }
+    Dual eval_dual(const util::VectorT & /*x*/, const util::VectorT & /*dir*/) const noexcept override { return {value, 0.}; }
+    FnKind kind() const noexcept override { return FnKind::Const; }
     std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
     std::unique_ptr<Fn> clone() const noexcept override { return std::make_unique<Const>(value); }
     std::ostream & print(std::ostream & out) const override { return out << value; }
@@ -167,6 +350,31 @@ struct Const : Fn
     double value;
 };
 
+namespace detail {
+
+/*
+ * Temporary buffer for batched evaluation.
+ * Storage is reused between evaluations in the same thread.
+ */
+struct BatchBuffer
+{
+    explicit BatchBuffer(std::size_t count);
+    ~BatchBuffer();
+
+    BatchBuffer(const BatchBuffer &) = delete;
+    BatchBuffer & operator=(const BatchBuffer &) = delete;
+
+    double * data() noexcept { return m_buf.data(); }
+
+private:
+    std::vector<double> m_buf;
+};
+
+// Prints base of power, negative constant is put in parentheses, as "-c ^ p" is read as "-(c ^ p)"
+std::ostream & print_base(std::ostream & out, const Fn & base);
+
+} // namespace detail
+
 template <class Oper>
 struct BinOp : Fn, Oper
 {
@@ -183,6 +391,33 @@ struct BinOp : Fn, Oper
         return as_op()(l_res, r_res);
     }
 
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override
+    {
+        detail::BatchBuffer r_res(count);
+        m_l->eval_batch(xs, count, out);
+        m_r->eval_batch(xs, count, r_res.data());
+
+        const double * r_data = r_res.data();
+#pragma omp simd
+        for (std::size_t k = 0; k < count; ++k) {
+            out[k] = as_op()(out[k], r_data[k]);
+        }
+    }
+
+    const Fn & lhs() const noexcept { return *m_l; }
+    const Fn & rhs() const noexcept { return *m_r; }
+
+    unsigned child_cnt() const noexcept override { return 2; }
+    const Fn & child(unsigned idx) const noexcept override { return idx == 0 ? *m_l : *m_r; }
+
+    std::vector<std::unique_ptr<Fn>> take_children() noexcept override
+    {
+        std::vector<std::unique_ptr<Fn>> res;
+        res.push_back(std::move(m_l));
+        res.push_back(std::move(m_r));
+        return res;
+    }
+
 private:
     const Oper & as_op() const noexcept { return *static_cast<const Oper *>(this); }
 
@@ -197,7 +432,10 @@ struct Add : BinOp<std::plus<double>>
     using Super::Super;
 
     std::unique_ptr<Fn> clone() const noexcept override { return add(m_l->clone(), m_r->clone()); }
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return add(std::move(ch[0]), std::move(ch[1])); }
+    FnKind kind() const noexcept override { return FnKind::Add; }
 
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
     std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
     std::ostream & print(std::ostream & out) const override { return out << '(' << (*m_l) << " + " << (*m_r) << ')'; }
 };
@@ -208,7 +446,10 @@ struct Sub : BinOp<std::minus<double>>
     using Super::Super;
 
     std::unique_ptr<Fn> clone() const noexcept override { return sub(m_l->clone(), m_r->clone()); }
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return sub(std::move(ch[0]), std::move(ch[1])); }
+    FnKind kind() const noexcept override { return FnKind::Sub; }
 
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
     std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
     std::ostream & print(std::ostream & out) const override { return out << '(' << (*m_l) << " - " << (*m_r) << ')'; }
 };
@@ -219,11 +460,103 @@ struct Mul : BinOp<std::multiplies<double>>
     using Super::Super;
 
     std::unique_ptr<Fn> clone() const noexcept override { return mul(m_l->clone(), m_r->clone()); }
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return mul(std::move(ch[0]), std::move(ch[1])); }
+    FnKind kind() const noexcept override { return FnKind::Mul; }
 
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
     std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
     std::ostream & print(std::ostream & out) const override { return out << '(' << (*m_l) << " * " << (*m_r) << ')'; }
 };
 
+struct Div : BinOp<std::divides<double>>
+{
+    using Super = BinOp<std::divides<double>>;
+    using Super::Super;
+
+    std::unique_ptr<Fn> clone() const noexcept override { return div(m_l->clone(), m_r->clone()); }
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return div(std::move(ch[0]), std::move(ch[1])); }
+    FnKind kind() const noexcept override { return FnKind::Div; }
+
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
+    std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
+    std::ostream & print(std::ostream & out) const override { return out << '(' << (*m_l) << " / " << (*m_r) << ')'; }
+};
+
+/*
+ * Linear combination: constant + coef_1 * term_1 + ... + coef_n * term_n.
+ * Built by "add" and "sub" when sums are chained, so long sums are evaluated
+ * by a single loop over terms instead of a deep chain of binary nodes.
+ */
+struct Sum : Fn
+{
+    Sum(std::vector<std::unique_ptr<Fn>> terms, std::vector<double> coefs, double constant);
+
+    std::unique_ptr<Fn> clone() const noexcept override;
+    double operator()(const util::VectorT & x) const noexcept override
+    {
+        double res = m_constant;
+        for (std::size_t i = 0; i < m_terms.size(); ++i) {
+            res += m_coefs[i] * (*m_terms[i])(x);
+        }
+        return res;
+    }
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override;
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
+    std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
+    std::ostream & print(std::ostream & out) const override;
+
+    FnKind kind() const noexcept override { return FnKind::Sum; }
+    unsigned child_cnt() const noexcept override { return m_terms.size(); }
+    const Fn & child(unsigned idx) const noexcept override { return *m_terms[idx]; }
+    std::vector<std::unique_ptr<Fn>> take_children() noexcept override { return std::move(m_terms); }
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return sum(std::move(ch), m_coefs, m_constant); }
+
+    const std::vector<double> & coefs() const noexcept { return m_coefs; }
+    double constant() const noexcept { return m_constant; }
+    // Move coefficients out together with children (see take_children)
+    std::vector<double> take_coefs() noexcept { return std::move(m_coefs); }
+
+private:
+    std::vector<std::unique_ptr<Fn>> m_terms;
+    std::vector<double> m_coefs;
+    double m_constant;
+};
+
+/*
+ * Product: coef * factor_1 * ... * factor_n.
+ * Built by "mul" when products are chained.
+ */
+struct Product : Fn
+{
+    Product(std::vector<std::unique_ptr<Fn>> factors, double coef);
+
+    std::unique_ptr<Fn> clone() const noexcept override;
+    double operator()(const util::VectorT & x) const noexcept override
+    {
+        double res = m_coef;
+        for (const auto & factor : m_factors) {
+            res *= (*factor)(x);
+        }
+        return res;
+    }
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override;
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
+    std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
+    std::ostream & print(std::ostream & out) const override;
+
+    FnKind kind() const noexcept override { return FnKind::Product; }
+    unsigned child_cnt() const noexcept override { return m_factors.size(); }
+    const Fn & child(unsigned idx) const noexcept override { return *m_factors[idx]; }
+    std::vector<std::unique_ptr<Fn>> take_children() noexcept override { return std::move(m_factors); }
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return product(std::move(ch), m_coef); }
+
+    double coef() const noexcept { return m_coef; }
+
+private:
+    std::vector<std::unique_ptr<Fn>> m_factors;
+    double m_coef;
+};
+
 struct Pow : Fn
 {
     Pow(std::unique_ptr<Fn> base, int pow)
@@ -233,13 +566,169 @@ struct Pow : Fn
     {}
 
     std::unique_ptr<Fn> clone() const noexcept override { return pow(m_base->clone(), m_pow); }
-    double operator()(const util::VectorT & x) const noexcept override { return std::pow((*m_base)(x), m_pow); }
+    // Computed by repeated squaring, so base is counted once
+    double operator()(const util::VectorT & x) const noexcept override { return util::simd::ipow((*m_base)(x), m_pow); }
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override;
+    // base ^ p and p * base ^ (p - 1) are counted together
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
     std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
-    std::ostream & print(std::ostream & out) const override { return out << '(' << (*m_base) << " ^ " << m_pow << ')'; }
+    std::ostream & print(std::ostream & out) const override { return detail::print_base(out << '(', *m_base) << " ^ " << m_pow << ')'; }
+
+    FnKind kind() const noexcept override { return FnKind::Pow; }
+    unsigned child_cnt() const noexcept override { return 1; }
+    const Fn & child(unsigned /*idx*/) const noexcept override { return *m_base; }
+    std::vector<std::unique_ptr<Fn>> take_children() noexcept override;
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return pow(std::move(ch[0]), m_pow); }
+
+    const Fn & base() const noexcept { return *m_base; }
+    int power() const noexcept { return m_pow; }
 
 private:
     std::unique_ptr<Fn> m_base;
     int m_pow;
 };
 
+/*
+ * Power with non-integer exponent, defined for positive base only
+ */
+struct RealPow : Fn
+{
+    RealPow(std::unique_ptr<Fn> base, double pow)
+        : Fn(base->dims())
+        , m_base(std::move(base))
+        , m_pow(pow)
+    {}
+
+    std::unique_ptr<Fn> clone() const noexcept override { return pow(m_base->clone(), m_pow); }
+    double operator()(const util::VectorT & x) const noexcept override { return std::pow((*m_base)(x), m_pow); }
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override;
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override;
+    std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override;
+    std::ostream & print(std::ostream & out) const override { return detail::print_base(out << '(', *m_base) << " ^ " << m_pow << ')'; }
+
+    FnKind kind() const noexcept override { return FnKind::RealPow; }
+    unsigned child_cnt() const noexcept override { return 1; }
+    const Fn & child(unsigned /*idx*/) const noexcept override { return *m_base; }
+    std::vector<std::unique_ptr<Fn>> take_children() noexcept override;
+    std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return pow(std::move(ch[0]), m_pow); }
+
+    const Fn & base() const noexcept { return *m_base; }
+    double power() const noexcept { return m_pow; }
+
+private:
+    std::unique_ptr<Fn> m_base;
+    double m_pow;
+};
+
+namespace fn_ops {
+
+/*
+ * Unary operations: scalar and in-place batched versions
+ */
+#define M(type, func) \
+    struct type##Op \
+    { \
+        double operator()(double x) const noexcept { return std::func(x); } \
+        void operator()(double * inout, std::size_t n) const noexcept { util::simd::func(inout, n); } \
+        static constexpr const char * Name = #func; \
+    }
+
+M(Exp, exp);
+M(Log, log);
+M(Sqrt, sqrt);
+M(Sin, sin);
+M(Cos, cos);
+
+#undef M
+
+} // namespace fn_ops
+
+template <class Oper>
+struct UnaryOp : Fn, Oper
+{
+    UnaryOp(std::unique_ptr<Fn> arg)
+        : Fn(arg->dims())
+        , m_arg(std::move(arg))
+    {}
+
+    double operator()(const util::VectorT & x) const noexcept override { return as_op()((*m_arg)(x)); }
+
+    void eval_batch(const double * xs, std::size_t count, double * out) const noexcept override
+    {
+        m_arg->eval_batch(xs, count, out);
+        as_op()(out, count);
+    }
+
+    std::ostream & print(std::ostream & out) const override { return out << Oper::Name << '(' << (*m_arg) << ')'; }
+
+    const Fn & arg() const noexcept { return *m_arg; }
+
+    unsigned child_cnt() const noexcept override { return 1; }
+    const Fn & child(unsigned /*idx*/) const noexcept override { return *m_arg; }
+
+    std::vector<std::unique_ptr<Fn>> take_children() noexcept override
+    {
+        std::vector<std::unique_ptr<Fn>> res;
+        res.push_back(std::move(m_arg));
+        return res;
+    }
+
+private:
+    const Oper & as_op() const noexcept { return *static_cast<const Oper *>(this); }
+
+protected:
+    std::unique_ptr<Fn> m_arg;
+};
+
+#define M(type, builder) \
+    struct type : UnaryOp<fn_ops::type##Op> \
+    { \
+        using Super = UnaryOp<fn_ops::type##Op>; \
+        using Super::Super; \
+\
+        std::unique_ptr<Fn> clone() const noexcept override { return builder(m_arg->clone()); } \
+        std::unique_ptr<Fn> with_children(std::vector<std::unique_ptr<Fn>> ch) const noexcept override { return builder(std::move(ch[0])); } \
+        FnKind kind() const noexcept override { return FnKind::type; } \
+\
+        Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override; \
+        std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override; \
+    }
+
+M(Exp, exp);
+M(Log, log);
+M(Sqrt, sqrt);
+M(Sin, sin);
+M(Cos, cos);
+
+#undef M
+
+template <class Visitor>
+auto Fn::call_func(Visitor && visitor) const
+{
+#define M(type) \
+    case FnKind::type: return visitor(static_cast<const type &>(*this))
+
+    switch (kind()) {
+        M(Const);
+        M(Variable);
+        M(Add);
+        M(Sub);
+        M(Mul);
+        M(Div);
+        M(Sum);
+        M(Product);
+        M(Pow);
+        M(RealPow);
+        M(Exp);
+        M(Log);
+        M(Sqrt);
+        M(Sin);
+        M(Cos);
+    case FnKind::Custom: break;
+    }
+
+#undef M
+    return visitor(*this);
+}
+
 using Function = Fn;
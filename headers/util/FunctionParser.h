@@ -0,0 +1,34 @@
+/*
+ *  Reading functions from text
+ */
+#pragma once
+
+#include "util/Function.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+/*
+ * Parse expression in the syntax emitted by Fn::print:
+ *  - numbers, variables "x0", "x1", ...
+ *  - binary "+", "-", "*", "/" with usual precedence, "^" with numeric exponent
+ *  - unary minus, binding weaker than "^" ("-x ^ 2" is "-(x ^ 2)"), parentheses,
+ *    functions "exp", "log", "sqrt", "sin", "cos"
+ * Expression may span several lines. Tree is built with the usual builders,
+ * so chains of "+" and "*" become Sum and Product nodes.
+ * Returns nullptr on error, then "error" (if given) receives its description.
+ */
+std::unique_ptr<Fn> parse_function(std::string_view text, std::string * error = nullptr);
+
+/*
+ * Parse expression from file.
+ * File is memory-mapped and read sequentially: text is never copied and
+ * pages already parsed are released at any depth of parentheses, so models of any size
+ * are read without keeping them in memory. Use Fn::ArenaScope to build nodes in arena.
+ */
+std::unique_ptr<Fn> load_function(const std::string & path, std::string * error = nullptr);
+
+} // namespace util
@@ -0,0 +1,71 @@
+/*
+ *  Passes over expression trees
+ */
+#pragma once
+
+#include "util/Function.h"
+
+#include <memory>
+#include <vector>
+
+/*
+ * Structural total order of expressions: returns negative, zero or positive value.
+ * Custom nodes are equal only to themselves.
+ */
+int compare(const Fn & lhs, const Fn & rhs);
+
+/*
+ * Structural equality of expressions
+ */
+inline bool equal(const Fn & lhs, const Fn & rhs) { return compare(lhs, rhs) == 0; }
+
+/*
+ * Count of nodes in the expression tree
+ */
+unsigned node_count(const Fn & fn);
+
+/*
+ * Bottom-up rewrite of the tree.
+ * Each node is rebuilt over its already rewritten children
+ * and then replaced with "rule(std::move(rebuilt_node))".
+ */
+template <class Rule>
+std::unique_ptr<Fn> rewrite(const Fn & fn, Rule && rule)
+{
+    std::vector<std::unique_ptr<Fn>> children;
+    children.reserve(fn.child_cnt());
+    for (unsigned i = 0; i < fn.child_cnt(); ++i) {
+        children.push_back(rewrite(fn.child(i), rule));
+    }
+    return rule(fn.with_children(std::move(children)));
+}
+
+/*
+ * Strength reduction of powers:
+ *  (b ^ p) ^ q     -> b ^ (p * q)
+ *  b ^ p * b ^ q   -> b ^ (p + q)
+ *  b ^ -p          -> 1 / b ^ p
+ *  l * (1 / r)     -> l / r
+ */
+std::unique_ptr<Fn> optimize_powers(const Fn & fn);
+
+/*
+ * Nodes' count before and after simplification
+ */
+struct SimplifyStats
+{
+    unsigned nodes_before = 0;
+    unsigned nodes_after = 0;
+
+    unsigned reduction() const noexcept { return nodes_before - nodes_after; }
+};
+
+/*
+ * Rule-based algebraic simplification:
+ *  - sums and products are flattened, their constants are folded
+ *  - like terms are collected: 2 * a + a * 3 - a -> 4 * a, a - a -> 0
+ *  - like factors are collected into powers: a * b / a ^ 2 -> b / a
+ *  - terms and factors are sorted to canonical order
+ * If "stats" is given, nodes' counts are added to it.
+ */
+std::unique_ptr<Fn> simplify(const Fn & fn, SimplifyStats * stats = nullptr);
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace util {
+
+/*
+ * Instrumentation of searchers: evaluation counters and phase timings.
+ * Timings and per-iteration statistics are enabled by NEWTONE_INSTRUMENT definition
+ * (CMake option of the same name), otherwise they compile to nothing.
+ * Calls of phases are always counted, search results (see util/Optimizer.h) report them.
+ */
+#ifdef NEWTONE_INSTRUMENT
+inline constexpr bool InstrumentEnabled = true;
+#else
+inline constexpr bool InstrumentEnabled = false;
+#endif
+
+enum struct Phase : unsigned
+{
+    Func,           // function evaluation
+    Grad,           // gradient evaluation
+    Hessian,        // hessian evaluation
+    LinearSolve,    // solving system of linear equations
+    LineSearch,     // one-dimensional minimization, includes its function evaluations
+    Update,         // anti-hessian (or other method's state) update
+    Count,
+};
+
+inline constexpr std::size_t PhaseCount = static_cast<std::size_t>(Phase::Count);
+
+const char * phase_name(Phase phase) noexcept;
+
+// Timestamp counter on x86, steady clock nanoseconds elsewhere
+inline std::uint64_t read_ticks() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Ticks in one millisecond, measured once on the first call
+double ticks_per_ms();
+
+struct PhaseCounters
+{
+    struct Entry
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t ticks = 0;
+    };
+
+    Entry & operator[](Phase phase) noexcept { return m_entries[static_cast<std::size_t>(phase)]; }
+    const Entry & operator[](Phase phase) const noexcept { return m_entries[static_cast<std::size_t>(phase)]; }
+
+    PhaseCounters operator-(const PhaseCounters & other) const noexcept
+    {
+        PhaseCounters res;
+        for (std::size_t i = 0; i < PhaseCount; ++i) {
+            res.m_entries[i] = {m_entries[i].calls - other.m_entries[i].calls, m_entries[i].ticks - other.m_entries[i].ticks};
+        }
+        return res;
+    }
+
+    bool empty() const noexcept
+    {
+        for (const auto & entry : m_entries) {
+            if (entry.calls != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::array<Entry, PhaseCount> m_entries = {};
+};
+
+/*
+ * Counters of the current thread, so concurrently running searchers don't share cache lines
+ */
+inline PhaseCounters & thread_counters() noexcept
+{
+    static thread_local PhaseCounters counters;
+    return counters;
+}
+
+/*
+ * Counts call of the phase in the current thread's counters and adds its lifetime to them
+ */
+struct PhaseTimer
+{
+    explicit PhaseTimer(Phase phase) noexcept
+        : m_phase(phase)
+    {
+        if constexpr (InstrumentEnabled) {
+            m_start = read_ticks();
+        }
+    }
+
+    ~PhaseTimer()
+    {
+        auto & entry = thread_counters()[m_phase];
+        ++entry.calls;
+        if constexpr (InstrumentEnabled) {
+            entry.ticks += read_ticks() - m_start;
+        }
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer & operator=(const PhaseTimer &) = delete;
+
+private:
+    Phase m_phase;
+    std::uint64_t m_start = 0;
+};
+
+/*
+ * Statistics of one search: counters of every iteration and of the whole search.
+ * Searcher calls start() before the first iteration, next_iteration() after each one and finish() at the end.
+ */
+struct SearchStats
+{
+    void start() noexcept
+    {
+        if constexpr (InstrumentEnabled) {
+            m_iterations.clear();
+            m_total = {};
+            m_start = m_last = thread_counters();
+        }
+    }
+
+    void next_iteration()
+    {
+        if constexpr (InstrumentEnabled) {
+            const auto & now = thread_counters();
+            m_iterations.push_back(now - m_last);
+            m_last = now;
+        }
+    }
+
+    void finish()
+    {
+        if constexpr (InstrumentEnabled) {
+            const auto & now = thread_counters();
+            if (!(now - m_last).empty()) {
+                m_iterations.push_back(now - m_last);
+            }
+            m_total = now - m_start;
+        }
+    }
+
+    const PhaseCounters & total() const noexcept { return m_total; }
+    const std::vector<PhaseCounters> & iterations() const noexcept { return m_iterations; }
+
+    // Table of calls and milliseconds spent in every phase
+    friend std::ostream & operator<<(std::ostream & out, const SearchStats & stats);
+
+private:
+    PhaseCounters m_total;
+    std::vector<PhaseCounters> m_iterations;
+
+    PhaseCounters m_start;
+    PhaseCounters m_last;
+};
+
+} // namespace util
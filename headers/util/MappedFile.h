@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace util {
+
+/*
+ * Read-only memory mapping of a whole file.
+ * Pages are loaded by OS on first access, so opening is cheap even for huge files.
+ */
+struct MappedFile
+{
+    static std::optional<MappedFile> open(const std::string & path);
+
+    MappedFile(MappedFile && other) noexcept;
+    MappedFile & operator=(MappedFile && other) noexcept;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    const char * data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+
+    // Hint, that file is going to be read from beginning to end
+    void advise_sequential() const noexcept;
+    // Hint, that pages of [0, offset) are not needed anymore, so OS may drop them
+    void release_before(std::size_t offset) const noexcept;
+
+private:
+    MappedFile(const char * data, std::size_t size)
+        : m_data(data)
+        , m_size(size)
+    {}
+
+    const char * m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+/*
+ * Writable shared memory mapping of a file, which grows on demand.
+ * File is truncated to the written size when it's closed.
+ */
+struct MappedOutput
+{
+    static std::optional<MappedOutput> create(const std::string & path);
+
+    MappedOutput(MappedOutput && other) noexcept;
+    MappedOutput & operator=(MappedOutput && other) noexcept;
+    ~MappedOutput();
+
+    MappedOutput(const MappedOutput &) = delete;
+    MappedOutput & operator=(const MappedOutput &) = delete;
+
+    // Extends written part by "bytes", returns pointer to them (valid until the next append) or nullptr on failure
+    char * append(std::size_t bytes) noexcept;
+    // Drops everything written after "size"
+    void rewind(std::size_t size) noexcept;
+
+    char * data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+
+private:
+    MappedOutput(int fd)
+        : m_fd(fd)
+    {}
+
+    void close() noexcept;
+
+    int m_fd = -1;
+    char * m_data = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_capacity = 0;
+};
+
+} // namespace util
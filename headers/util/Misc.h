@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <string_view>
@@ -8,6 +9,8 @@
 namespace util {
 
 using CalculateFunc = std::function<double(double)>;
+// Calculates function in "count" points "xs" at once
+using CalculateBatchFunc = std::function<void(const double * xs, std::size_t count, double * out)>;
 
 template <class Container>
 struct is_container
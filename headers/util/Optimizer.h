@@ -0,0 +1,160 @@
+/*
+ *  Common interface of n-dimensional searchers: stopping criteria and search result
+ */
+#pragma once
+
+#include "util/Function.h"
+#include "util/Instrument.h"
+#include "util/SearchState.h"
+#include "util/VectorOps.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace util {
+
+enum struct StopReason
+{
+    None,               // search didn't run
+    GradientNorm,       // gradient is small enough
+    StepSize,           // step is small enough
+    MaxIterations,
+    MaxEvaluations,
+    TimeLimit,
+    NotFinite,          // step or gradient became infinite or NaN
+    LineSearchFailed,   // no step along the direction decreased function enough
+};
+
+const char * stop_reason_name(StopReason reason) noexcept;
+
+/*
+ * Stopping criteria of a search, zero disables criterion.
+ * Every searcher sets its defaults from its precision.
+ */
+struct StopCriteria
+{
+    double grad_norm = 0.;              // stop, when |grad f(x)| < grad_norm
+    double step = 0.;                   // stop, when |x_next - x| < step
+    unsigned max_iterations = 0;
+    std::uint64_t max_evaluations = 0;  // of function, gradient and hessian together
+    double time_limit_ms = 0.;
+};
+
+struct SearchResult
+{
+    VectorT point;
+    double value = 0.;                  // function's value in the point
+    double grad_norm = 0.;              // gradient's length in the point
+    unsigned iterations = 0;
+    std::uint64_t func_evals = 0;       // including line searches
+    std::uint64_t grad_evals = 0;
+    std::uint64_t hessian_evals = 0;
+    double time_ms = 0.;
+    StopReason reason = StopReason::None;
+
+    // Stopped by gradient, or by step with gradient shorter than "max_grad_norm"
+    bool converged(double max_grad_norm) const noexcept
+    {
+        return reason == StopReason::GradientNorm || (reason == StopReason::StepSize && grad_norm < max_grad_norm);
+    }
+
+    friend std::ostream & operator<<(std::ostream & out, const SearchResult & result);
+};
+
+/*
+ * Reason to stop by step's and gradient's lengths (negative, if unknown), None if search continues
+ */
+StopReason progress_reason(const StopCriteria & criteria, double step, double grad_norm) noexcept;
+
+/*
+ * Checks stopping criteria in search's iterations.
+ * Searcher calls start() before the first iteration,
+ * stop_on_progress() when step or gradient is known and stop_on_limits() before every iteration.
+ */
+struct Termination
+{
+    void start(const StopCriteria & criteria);
+
+    /*
+     * Returns true, if step's length or gradient's length (negative, if unknown) is small enough
+     * or isn't finite
+     */
+    bool stop_on_progress(double step, double grad_norm = -1.);
+    // Returns true, if "iterations" done exhaust the iterations, evaluations or time limit
+    bool stop_on_limits(unsigned iterations);
+
+    StopReason reason() const noexcept { return m_reason; }
+    // Gradient's length given to stop_on_progress(), which stopped the search (negative, if unknown)
+    double grad_norm() const noexcept { return m_grad_norm; }
+    unsigned iterations() const noexcept { return m_iterations; }
+    // Phase counters since start
+    PhaseCounters counters() const noexcept { return thread_counters() - m_counters; }
+    double elapsed_ms() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    StopCriteria m_criteria;
+    StopReason m_reason = StopReason::None;
+    double m_grad_norm = -1.;
+    unsigned m_iterations = 0;
+    PhaseCounters m_counters;
+    Clock::time_point m_start;
+};
+
+/*
+ * Searcher, which can be used without knowing its family (e.g. to route problems between methods)
+ */
+struct Optimizer
+{
+    virtual ~Optimizer() = default;
+
+    virtual std::string_view method_name() const noexcept = 0;
+
+    /*
+     * Find function's minimum starting from "init" (origin, if empty).
+     * Result's value is evaluated at the found point. Gradient's length is taken from the stop test of searcher,
+     * if it stopped by progress there, otherwise it's evaluated by directional derivatives along coordinates.
+     * Neither is counted as evaluation.
+     */
+    SearchResult minimize(const Function & func, VectorT init = {});
+
+    void set_stop_criteria(const StopCriteria & criteria) noexcept { m_criteria = criteria; }
+    const StopCriteria & stop_criteria() const noexcept { return m_criteria; }
+
+    // State at the end of the last search, it can be saved as checkpoint
+    const SearchState & state() const noexcept { return m_state; }
+    /*
+     * With warm start the next search of function of the same dimension continues from the state:
+     * it starts from its point (if initial point isn't given) and uses its curvature and step,
+     * so sequences of close problems take fewer iterations
+     */
+    void set_warm_start(bool warm) noexcept { m_warm_start = warm; }
+    // Continue from the given state (e.g. loaded checkpoint), enables warm start
+    void resume(SearchState state)
+    {
+        m_state = std::move(state);
+        m_warm_start = true;
+    }
+
+protected:
+    virtual VectorT minimize_impl(const Function & func, VectorT init) = 0;
+
+    // State to continue from in search of function of "dims" dimensions, nullptr if search starts from scratch
+    const SearchState * warm_state(unsigned dims) const noexcept
+    {
+        return m_warm_start && m_state.dims() == dims ? &m_state : nullptr;
+    }
+    // "init", if it's given, otherwise warm start point or origin
+    VectorT initial_point(unsigned dims, VectorT init) const;
+
+protected:
+    StopCriteria m_criteria;
+    Termination m_termination;      // State of criteria in the current search
+    SearchState m_state;            // Filled by searcher at the end of search
+    bool m_warm_start = false;
+};
+
+} // namespace util
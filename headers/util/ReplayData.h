@@ -1,17 +1,30 @@
 #pragma once
 
+#include "util/MappedFile.h"
 #include "util/Misc.h"
 #include "util/VersionedData.h"
 
-#include "sd_methods/Function.h"
-
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
-#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace util {
 
+struct TraceExporter;
+
+/*
+ * Trace of a search: append-only sequence of fixed-width records.
+ * Coordinates of a point are stored contiguously right after its record,
+ * comments are interned, so repeated comment costs a single record.
+ * Memory and file use the same layout, so trace can be streamed to a mapped file
+ * while the search runs and read back by ReplayReader.
+ */
 struct ReplayData
 {
 private:
@@ -23,21 +36,144 @@ private:
     static constexpr bool IsVersionedData = std::is_base_of_v<VersionedData, T>;
 
 public:
-    using VdDataPtr = std::unique_ptr<const VersionedData>;
-    using iterator = std::vector<VdDataPtr>::const_iterator;
+    struct Record
+    {
+        std::uint32_t kind;         // VdDataKind or CommentText
+        std::uint32_t version;
+        std::uint64_t size;         // point: number of coordinates after the record; comment text: its length
+        std::uint64_t payload;      // value: bits of double; comment and comment text: id of comment
+    };
+    static constexpr std::size_t RecordWords = sizeof(Record) / sizeof(std::uint64_t);
+
+    // Kind of record, which introduces text of the next comment id, the text follows the record
+    static constexpr std::uint32_t CommentText = 0xff;
+
+    /*
+     * Single point, value or comment of trace
+     */
+    struct Entry
+    {
+        Entry(const Record * record, const std::string * comments)
+            : m_record(record)
+            , m_comments(comments)
+        {}
+
+        VdDataKind kind() const noexcept { return static_cast<VdDataKind>(m_record->kind); }
+        uint version() const noexcept { return m_record->version; }
+
+        // Point's coordinates
+        const double * coords() const noexcept { return reinterpret_cast<const double *>(m_record + 1); }
+        std::size_t size() const noexcept { return m_record->size; }
+        // Value
+        double value() const noexcept
+        {
+            double res;
+            std::memcpy(&res, &m_record->payload, sizeof(res));
+            return res;
+        }
+        // Comment
+        const std::string & comment() const noexcept { return m_comments[m_record->payload]; }
+
+        /*
+         * Calls "func" with VdPoint, VdValue or VdComment made of the entry
+         */
+        template <class Func>
+        auto call_func(Func && func) const
+        {
+            switch (kind()) {
+            case VdDataKind::VdPointKind: return func(VdPoint(version(), std::vector<double>(coords(), coords() + size())));
+            case VdDataKind::VdValueKind: return func(VdValue(version(), value()));
+            case VdDataKind::VdCommentKind: return func(VdComment(version(), comment()));
+            default: assert(false && "There is no such VersionedData kind");
+            }
+            return func(VdValue(version(), value()));
+        }
+
+    private:
+        const Record * m_record;
+        const std::string * m_comments;
+    };
+
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Entry;
+
+        iterator(const std::uint64_t * pos, const std::uint64_t * end, const std::string * comments)
+            : m_pos(pos)
+            , m_end(end)
+            , m_comments(comments)
+        { skip_comment_texts(); }
+
+        Entry operator*() const noexcept { return {record(), m_comments}; }
+
+        iterator & operator++() noexcept
+        {
+            m_pos += record_words(*record());
+            skip_comment_texts();
+            return *this;
+        }
+        iterator operator++(int) noexcept
+        {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        bool operator==(const iterator & other) const noexcept { return m_pos == other.m_pos; }
+        bool operator!=(const iterator & other) const noexcept { return m_pos != other.m_pos; }
+
+    private:
+        const Record * record() const noexcept { return reinterpret_cast<const Record *>(m_pos); }
+
+        void skip_comment_texts() noexcept
+        {
+            while (m_pos != m_end && record()->kind == CommentText) {
+                m_pos += record_words(*record());
+            }
+        }
+
+        const std::uint64_t * m_pos;
+        const std::uint64_t * m_end;
+        const std::string * m_comments;
+    };
+
+    // Number of words occupied by record with its trailing data
+    static std::size_t record_words(const Record & record) noexcept
+    {
+        switch (record.kind) {
+        case static_cast<std::uint32_t>(VdDataKind::VdPointKind): return RecordWords + record.size;
+        case CommentText: return RecordWords + (record.size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+        default: return RecordWords;
+        }
+    }
 
-    iterator begin() const { return m_data.begin(); }
-    iterator end() const { return m_data.end(); }
+    ReplayData() = default;
+    ReplayData(ReplayData &&) = default;
+    ReplayData & operator=(ReplayData &&) = default;
+
+    iterator begin() const { return {words(), words() + word_cnt(), m_comments.data()}; }
+    iterator end() const { return {words() + word_cnt(), words() + word_cnt(), m_comments.data()}; }
+    bool empty() const noexcept { return begin() == end(); }
+
+    // Bytes occupied by records (in memory or in file)
+    std::size_t size_bytes() const noexcept { return word_cnt() * sizeof(std::uint64_t); }
+
+    void add_point(uint version, const double * coords, std::size_t size);
+    void add_point(uint version, const std::vector<double> & coords) { add_point(version, coords.data(), coords.size()); }
+    void add_value(uint version, double val);
+    void add_comment(uint version, std::string_view comment);
 
     template <class Container>
     auto push_back(Container && cont) -> std::enable_if_t<
             is_container_v<std::decay_t<Container>> &&
             IsVersionedData<ContValType<Container>>>
     {
-        if constexpr (std::is_rvalue_reference_v<Container &&>) {
-            push_back_cont(Container{std::move(cont)}); // this way 'cont' will get moved from and thus cleared
-        } else {
-            push_back_cont(std::forward<Container>(cont));
+        for (const auto & el : cont) {
+            push_back(el);
         }
     }
 
@@ -47,53 +183,91 @@ public:
             is_unique_ptr_v<ContValType<Container>> &&
             IsVersionedData<typename ContValType<Container>::element_type>>
     {
-        static_assert(std::is_rvalue_reference_v<Container &&>, "Container of unique_ptr's should be moved");
-        push_back_cont(Container{std::move(cont)}); // this way 'cont' will get moved from and thus cleared
+        for (const auto & el : cont) {
+            push_back(*el);
+        }
     }
 
-    template <class VdData>
-    auto push_back(VdData && vd_data) -> std::enable_if_t<std::is_base_of_v<VersionedData, std::decay_t<VdData>>>
+    void push_back(const VersionedData & vd_data)
     {
-        using ValueType = std::decay_t<VdData>;
-
-        m_data.emplace_back(std::make_unique<const ValueType>(std::forward<VdData>(vd_data)));
-        m_total_versions = std::max(m_total_versions, vd_data.version());
+        vd_data.call_func(overload(
+            [this](const VdPoint & point) { add_point(point.version(), point.coords); },
+            [this](const VdValue & value) { add_value(value.version(), value.val); },
+            [this](const VdComment & comm) { add_comment(comm.version(), comm.comment); }
+        ));
     }
 
-
     template <class VdDataType, class... Args>
-    void emplace_back(Args &&... args) { m_data.emplace_back(std::make_unique<VdDataType>(std::forward<Args>(args)...)); }
+    void emplace_back(Args &&... args) { push_back(VdDataType(std::forward<Args>(args)...)); }
 
-    void clear()
-    {
-        m_data.clear();
-        m_total_versions = 0;
-    }
+    /*
+     * Records written so far and all the next ones go to file at "path" instead of memory.
+     * Returns false, if file can't be created.
+     */
+    bool stream_to(const std::string & path);
+    // Closes the file, the next records are kept in memory
+    void stop_streaming();
+
+    /*
+     * Every next record is also passed to "exporter" (nullptr to stop).
+     * Exporter must outlive the trace or be detached before destruction.
+     */
+    void export_to(TraceExporter * exporter) noexcept { m_exporter = exporter; }
+
+    void clear();
 
 private:
-    template <class Container>
-    void push_back_cont(Container && cont)
+    struct FileHeader
     {
-        m_data.reserve(m_data.size() + cont.size());
-        for (auto & el : cont) {
-            m_data.emplace_back(to_unique_ptr(to_same_ref_as(el, std::forward<Container>(cont))));
-            m_total_versions = std::max(m_total_versions, el.version());
-        }
-    }
+        char magic[8];
+        std::uint64_t format_version;
+    };
+    static constexpr std::size_t HeaderWords = sizeof(FileHeader) / sizeof(std::uint64_t);
 
-    template <class T>
-    static auto to_unique_ptr(T && from)
+    friend struct ReplayReader;
+
+    const std::uint64_t * words() const noexcept
     {
-        if constexpr (is_unique_ptr_v<T>) {
-            std::move(from);
-        } else {
-            return std::make_unique<std::decay_t<T>>(std::forward<T>(from));
-        }
+        return m_file ? reinterpret_cast<const std::uint64_t *>(m_file->data()) + HeaderWords : m_words.data();
+    }
+    std::size_t word_cnt() const noexcept
+    {
+        return m_file ? m_file->size() / sizeof(std::uint64_t) - HeaderWords : m_words.size();
     }
 
+    // Appends "count" words to the trace and returns pointer to them, nullptr if file can't grow
+    std::uint64_t * grow(std::size_t count);
+    Record * add_record(std::uint32_t kind, uint version, std::uint64_t size, std::uint64_t payload, std::size_t extra_words = 0);
+    // Passes completed record to exporter
+    void publish(const Record * record);
+
 private:
-    std::vector<VdDataPtr> m_data;
-    uint m_total_versions = 0;
+    std::vector<std::uint64_t> m_words;
+    std::optional<MappedOutput> m_file;
+    std::vector<std::string> m_comments;    // interned comments, record refers to comment by its index
+    TraceExporter * m_exporter = nullptr;
+};
+
+/*
+ * Trace, which was streamed to file, mapped back to memory
+ */
+struct ReplayReader
+{
+    using iterator = ReplayData::iterator;
+
+    // Returns nullopt, if file can't be read or is not a valid trace
+    static std::optional<ReplayReader> open(const std::string & path);
+
+    iterator begin() const { return {m_words, m_words + m_word_cnt, m_comments.data()}; }
+    iterator end() const { return {m_words + m_word_cnt, m_words + m_word_cnt, m_comments.data()}; }
+
+private:
+    ReplayReader(MappedFile file);
+
+    MappedFile m_file;
+    const std::uint64_t * m_words = nullptr;
+    std::size_t m_word_cnt = 0;
+    std::vector<std::string> m_comments;
 };
 
-} // namespace min1d
+} // namespace util
@@ -0,0 +1,34 @@
+/*
+ *  State of a search, which lets the next search continue from it (warm start)
+ */
+#pragma once
+
+#include "util/VectorOps.h"
+
+#include <optional>
+#include <string>
+
+namespace util {
+
+/*
+ * Everything a searcher learned about the function by the end of search:
+ * the found point, curvature estimate (anti-hessian of quasinewton methods, empty for others)
+ * and the last line search, which guesses the first step of the next one.
+ * Can be saved to file and loaded back to resume after restart.
+ */
+struct SearchState
+{
+    VectorT point;
+    MatrixT curvature;
+    double step = 0.;           // accepted step of the last line search, 0 if none
+    double der = 0.;            // directional derivative along its direction
+
+    unsigned dims() const noexcept { return point.size(); }
+    bool empty() const noexcept { return point.empty(); }
+
+    // Returns nullopt, if file is missing or is not a valid state
+    static std::optional<SearchState> load(const std::string & path);
+    bool save(const std::string & path) const;
+};
+
+} // namespace util
@@ -0,0 +1,230 @@
+/*
+ *  Elementwise kernels for batched function evaluation.
+ *  Loops are branch-free, so compiler is able to vectorize them
+ *  (exp and log are evaluated with polynomials instead of libm calls).
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace util::simd {
+
+namespace detail {
+
+inline std::int64_t as_bits(double val) noexcept
+{
+    std::int64_t res;
+    std::memcpy(&res, &val, sizeof(res));
+    return res;
+}
+
+inline double from_bits(std::int64_t bits) noexcept
+{
+    double res;
+    std::memcpy(&res, &bits, sizeof(res));
+    return res;
+}
+
+// Adding this number to |x| < 2^51 rounds it to integer, which is stored in low bits of mantissa
+constexpr double RoundMagic = 0x1.8p52;
+
+inline double round(double x) noexcept { return (x + RoundMagic) - RoundMagic; }
+
+// 2^n for integer n in [-1022, 1023]
+inline double exp2i(double n) noexcept
+{
+    std::int64_t bits = as_bits(n + RoundMagic) - as_bits(RoundMagic);
+    return from_bits((bits + 1023) << 52);
+}
+
+// integer n, stored in int64, as double
+inline double to_double(std::int64_t n) noexcept
+{
+    return from_bits(n + as_bits(RoundMagic)) - RoundMagic;
+}
+
+inline double exp(double x) noexcept
+{
+    constexpr double Log2e = 1.4426950408889634;
+    constexpr double Ln2Hi = 6.93147180369123816490e-01;
+    constexpr double Ln2Lo = 1.90821492927058770002e-10;
+    constexpr double MaxArg = 709.782712893384;
+    constexpr double MinArg = -745.1332191019412;
+
+    double arg = x < MinArg ? MinArg : (x > MaxArg ? MaxArg : x);
+    double n = round(arg * Log2e);
+    double r = (arg - n * Ln2Hi) - n * Ln2Lo;   // |r| <= ln(2) / 2
+
+    // Taylor series up to r^13 / 13!
+    double p = 1. / 6227020800.;
+    p = p * r + 1. / 479001600.;
+    p = p * r + 1. / 39916800.;
+    p = p * r + 1. / 3628800.;
+    p = p * r + 1. / 362880.;
+    p = p * r + 1. / 40320.;
+    p = p * r + 1. / 5040.;
+    p = p * r + 1. / 720.;
+    p = p * r + 1. / 120.;
+    p = p * r + 1. / 24.;
+    p = p * r + 1. / 6.;
+    p = p * r + 1. / 2.;
+    p = p * r + 1.;
+    p = p * r + 1.;
+
+    // 2^n is split in two factors, so subnormal results and n = 1024 are representable
+    double n1 = round(n * 0.5);
+    double res = p * exp2i(n1) * exp2i(n - n1);
+
+    res = x > MaxArg ? std::numeric_limits<double>::infinity() : res;
+    res = x < MinArg ? 0. : res;
+    return x != x ? x : res;
+}
+
+inline double log(double x) noexcept
+{
+    constexpr double Ln2 = 0.6931471805599453;
+    constexpr double Sqrt2 = 1.4142135623730951;
+    constexpr double MinNormal = std::numeric_limits<double>::min();
+    constexpr double Inf = std::numeric_limits<double>::infinity();
+
+    // subnormals are scaled to normal range
+    bool is_subnormal = x < MinNormal;
+    double arg = is_subnormal ? x * 0x1p54 : x;
+
+    std::int64_t bits = as_bits(arg);
+    std::int64_t exp_bits = (bits >> 52) & 0x7ff;
+    double m = from_bits((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);     // m in [1, 2)
+    double e = to_double(exp_bits - 1023) - (is_subnormal ? 54. : 0.);
+
+    // move m to [sqrt(2) / 2, sqrt(2)), so |s| is small
+    bool is_big = m > Sqrt2;
+    m = is_big ? m * 0.5 : m;
+    e = is_big ? e + 1. : e;
+
+    // log(m) = 2 * atanh(s), s = (m - 1) / (m + 1)
+    double s = (m - 1.) / (m + 1.);
+    double s2 = s * s;
+    double p = 1. / 21.;
+    p = p * s2 + 1. / 19.;
+    p = p * s2 + 1. / 17.;
+    p = p * s2 + 1. / 15.;
+    p = p * s2 + 1. / 13.;
+    p = p * s2 + 1. / 11.;
+    p = p * s2 + 1. / 9.;
+    p = p * s2 + 1. / 7.;
+    p = p * s2 + 1. / 5.;
+    p = p * s2 + 1. / 3.;
+    p = p * s2 + 1.;
+    double res = e * Ln2 + 2. * s * p;
+
+    res = x == Inf ? Inf : res;
+    res = x == 0. ? -Inf : res;
+    return (x < 0. || x != x) ? std::numeric_limits<double>::quiet_NaN() : res;
+}
+
+} // namespace detail
+
+/*
+ * Integer power by repeated squaring: base is multiplied at most 2 * log2(|p|) times
+ */
+inline double ipow(double base, int p) noexcept
+{
+    double res = 1.;
+    for (unsigned rest = p < 0 ? -static_cast<unsigned>(p) : p; rest != 0; rest >>= 1) {
+        if (rest & 1) {
+            res *= base;
+        }
+        base *= base;
+    }
+    return p < 0 ? 1. / res : res;
+}
+
+/*
+ * In-place kernels over "n" contiguous values.
+ */
+inline void exp(double * inout, std::size_t n) noexcept
+{
+#pragma omp simd
+    for (std::size_t k = 0; k < n; ++k) {
+        inout[k] = detail::exp(inout[k]);
+    }
+}
+
+inline void log(double * inout, std::size_t n) noexcept
+{
+#pragma omp simd
+    for (std::size_t k = 0; k < n; ++k) {
+        inout[k] = detail::log(inout[k]);
+    }
+}
+
+inline void sqrt(double * inout, std::size_t n) noexcept
+{
+#pragma omp simd
+    for (std::size_t k = 0; k < n; ++k) {
+        inout[k] = std::sqrt(inout[k]);
+    }
+}
+
+// sin and cos are vectorized only if libm provides vector versions (e.g. glibc's libmvec)
+inline void sin(double * inout, std::size_t n) noexcept
+{
+#pragma omp simd
+    for (std::size_t k = 0; k < n; ++k) {
+        inout[k] = std::sin(inout[k]);
+    }
+}
+
+inline void cos(double * inout, std::size_t n) noexcept
+{
+#pragma omp simd
+    for (std::size_t k = 0; k < n; ++k) {
+        inout[k] = std::cos(inout[k]);
+    }
+}
+
+// Repeated squaring over the whole batch, "scratch" must hold "n" values
+inline void ipow(double * inout, std::size_t n, int p, double * scratch) noexcept
+{
+    double * base = scratch;
+    std::copy_n(inout, n, base);
+    std::fill_n(inout, n, 1.);
+
+    for (unsigned rest = p < 0 ? -static_cast<unsigned>(p) : p; rest != 0; rest >>= 1) {
+        if (rest & 1) {
+#pragma omp simd
+            for (std::size_t k = 0; k < n; ++k) {
+                inout[k] *= base[k];
+            }
+        }
+        if (rest > 1) {
+#pragma omp simd
+            for (std::size_t k = 0; k < n; ++k) {
+                base[k] *= base[k];
+            }
+        }
+    }
+
+    if (p < 0) {
+#pragma omp simd
+        for (std::size_t k = 0; k < n; ++k) {
+            inout[k] = 1. / inout[k];
+        }
+    }
+}
+
+// base ^ p for real p as exp(p * log(base))
+inline void pow(double * inout, std::size_t n, double p) noexcept
+{
+#pragma omp simd
+    for (std::size_t k = 0; k < n; ++k) {
+        inout[k] = detail::exp(p * detail::log(inout[k]));
+    }
+}
+
+} // namespace util::simd
@@ -0,0 +1,141 @@
+/*
+ *  Functions compiled to linear programs, which can be saved to file and mapped back
+ */
+#pragma once
+
+#include "sole-solver/Matrix.h"
+#include "util/Function.h"
+#include "util/MappedFile.h"
+#include "util/VectorOps.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace util {
+
+/*
+ * Function with its gradient and hessian compiled to one linear program.
+ * Every instruction computes a value from results of previous instructions,
+ * equal subexpressions of function and derivatives are computed once.
+ * Instructions are ordered: function first, then gradient, then hessian,
+ * so evaluating function alone runs only the prefix of the tape.
+ *
+ * Only non-zero entries of the lower triangle of hessian are stored (sparsity pattern).
+ *
+ * Tape is a single flat image, which is written to file as is and is mapped back
+ * without any parsing (file is valid only on machines with the same byte order).
+ */
+struct Tape
+{
+    enum struct Op : std::uint32_t
+    {
+        Const,      // imm
+        Var,        // x[lhs]
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Scale,      // imm * lhs
+        AddScaled,  // lhs + imm * rhs
+        Pow,        // lhs ^ imm, imm is integer
+        RealPow,
+        Exp,
+        Log,
+        Sqrt,
+        Sin,
+        Cos,
+    };
+
+    struct Instr
+    {
+        Op op;
+        std::uint32_t lhs;
+        std::uint32_t rhs;
+        std::uint32_t reserved;
+        double imm;
+    };
+
+    struct HessianEntry
+    {
+        std::uint32_t row;
+        std::uint32_t col;      // col <= row
+        std::uint32_t slot;     // instruction computing the entry
+    };
+
+    /*
+     * Derivatives are built with Fn::grad. Functions with custom nodes are not compiled.
+     */
+    static std::optional<Tape> compile(const Fn & fn);
+
+    static std::optional<Tape> load(const std::string & path);
+    bool save(const std::string & path) const;
+
+    Tape(Tape &&) = default;
+    Tape & operator=(Tape &&) = default;
+    Tape(const Tape &) = delete;
+    Tape & operator=(const Tape &) = delete;
+
+    unsigned dims() const noexcept;
+    std::size_t instr_cnt() const noexcept;
+    std::size_t hessian_nnz() const noexcept;
+    const HessianEntry * hessian_pattern() const noexcept;
+
+    double operator()(const util::VectorT & x) const noexcept;
+    double eval(const util::VectorT & x, util::VectorT & grad) const noexcept;
+    // Hessian is fully overwritten: entries outside of the pattern are set to zero
+    double eval(const util::VectorT & x, util::VectorT & grad, Matrix & hessian) const noexcept;
+    // The same with hessian written to row-major array of dims() * dims() values
+    double eval(const util::VectorT & x, util::VectorT & grad, double * hessian) const noexcept;
+
+    /*
+     * Hessian in "x" right after eval(x, grad) in the same thread: only instructions after the gradient are run,
+     * so gradient and hessian can be timed separately without running the tape twice
+     */
+    void eval_hessian(const util::VectorT & x, Matrix & hessian) const noexcept;
+    void eval_hessian(const util::VectorT & x, double * hessian) const noexcept;
+
+    /*
+     * Function evaluated by the tape, so it can be passed to searchers.
+     * It shares the image with the tape, so it stays valid, when the tape is moved or destroyed.
+     * Its partial derivatives run the tape up to gradient and hessian entries, Newton and quasi-Newton
+     * searchers find the tape by backing() and evaluate all derivatives by one run instead.
+     */
+    std::unique_ptr<Fn> function() const;
+    // Tape evaluating "fn", if it's made by function(), nullptr otherwise (valid while "fn" is alive)
+    static const Tape * backing(const Fn & fn) noexcept;
+
+    // Leading part of the image, defined in Tape.cpp
+    struct Header;
+    // Function node evaluating one slot of the tape, defined in Tape.cpp
+    struct Node;
+
+private:
+    // Owned or mapped image, shared by the tape and its function nodes, defined in Tape.cpp
+    struct Image;
+
+    explicit Tape(std::vector<std::uint64_t> image);
+    explicit Tape(MappedFile file);
+    // Another tape over the same image
+    Tape share() const;
+    Tape(std::shared_ptr<const Image> image, const char * base, std::size_t size);
+
+    const Header & header() const noexcept;
+    const Instr * instrs() const noexcept;
+    const std::uint32_t * grad_slots() const noexcept;
+
+    /*
+     * Runs instructions from "first" to "last", returns results of all instructions (valid until next run in the same thread).
+     * Results of instructions before "first" are left from the previous run.
+     */
+    const double * run(const util::VectorT & x, std::size_t last, std::size_t first = 0) const noexcept;
+
+    std::shared_ptr<const Image> m_image;
+    const char * m_base;
+    std::size_t m_size;
+};
+
+} // namespace util
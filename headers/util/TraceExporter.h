@@ -0,0 +1,96 @@
+/*
+ *  Export of search traces to MATLAB, CSV or NPY files on a background thread
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+/*
+ * Receives trace records from ReplayData (see ReplayData::export_to) through a lock-free
+ * single producer, single consumer queue and writes them to file on its own thread,
+ * so formatting doesn't slow down the search.
+ *
+ * Formats:
+ *  Matlab  points as matrix "points", values as vectors named by their comments,
+ *          plus contour plot of projection of the function on two chosen coordinates
+ *          (other coordinates are fixed at the last point)
+ *  Csv     row per entry: "iter,name,values...", name is the preceding comment
+ *  Npy     numpy array of points, row is [iter, x0, x1, ...]
+ */
+struct TraceExporter
+{
+    enum struct Format
+    {
+        Matlab,
+        Csv,
+        Npy,
+    };
+
+    struct Options
+    {
+        Format format = Format::Csv;
+        std::array<unsigned, 2> projection = {0, 1};    // coordinates of MATLAB plot
+        std::string function;                           // printed function for MATLAB contour, no contour if empty
+        std::size_t queue_words = 1 << 16;              // capacity of queue in 8-byte words
+    };
+
+    // Returns nullptr, if file can't be created
+    static std::unique_ptr<TraceExporter> create(const std::string & path, Options options);
+
+    ~TraceExporter();
+
+    TraceExporter(const TraceExporter &) = delete;
+    TraceExporter & operator=(const TraceExporter &) = delete;
+
+    /*
+     * Enqueues a record with its trailing data (ReplayData layout), called on the search thread.
+     * Waits, if the queue is full. Records larger than the queue are passed in parts.
+     */
+    void push(const std::uint64_t * words, std::size_t count);
+
+    // Writes everything enqueued, completes the file and stops the thread
+    void finish();
+
+private:
+    TraceExporter(std::ofstream out, Options options);
+
+    void run();
+    bool consume();
+
+    void write_header();
+    void write_entry(const std::uint64_t * words);
+    void write_footer();
+
+private:
+    Options m_options;
+    std::ofstream m_out;
+
+    std::vector<std::uint64_t> m_queue;             // ring buffer, its size is a power of two
+    alignas(64) std::atomic<std::size_t> m_head{0}; // words pushed, written by producer only
+    alignas(64) std::atomic<std::size_t> m_tail{0}; // words consumed, written by consumer only
+    alignas(64) std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+
+    // State of the consumer thread
+    std::vector<std::uint64_t> m_record;            // current record copied out of the ring, maybe partially
+    std::vector<std::string> m_comments;
+    std::string m_label;                            // last comment, names the next entry
+    std::size_t m_dims = 0;                         // of the first point
+    std::size_t m_rows = 0;                         // points written
+    std::vector<double> m_last_point;
+    std::array<double, 2> m_min = {}, m_max = {};   // bounds of projection
+    std::vector<std::pair<std::string, std::vector<double>>> m_values;
+    std::string m_line;
+};
+
+} // namespace util
@@ -0,0 +1,37 @@
+#pragma once
+
+namespace util {
+
+/*
+ * Trace policies of searchers: decide, which iterations are written to ReplayData.
+ * Searcher with NoTrace policy has all logging compiled away.
+ */
+struct FullTrace
+{
+    static constexpr bool Enabled = true;
+
+    bool should_log(unsigned) const noexcept { return true; }
+};
+
+struct NoTrace
+{
+    static constexpr bool Enabled = false;
+
+    bool should_log(unsigned) const noexcept { return false; }
+};
+
+// Logs every "every"-th iteration
+struct SampledTrace
+{
+    static constexpr bool Enabled = true;
+
+    SampledTrace(unsigned every = 1)
+        : every(every == 0 ? 1 : every)
+    {}
+
+    bool should_log(unsigned iter_num) const noexcept { return iter_num % every == 0; }
+
+    unsigned every;
+};
+
+} // namespace util
@@ -28,4 +28,7 @@ MatrixT trans(MatrixT mtx);
 double scalar(const VectorT & lhs, const VectorT & rhs);
 double length(const VectorT & vec);
 
+// In-place lhs += rhs * scalar, doesn't allocate
+void add_scaled(VectorT & lhs, const VectorT & rhs, double scalar);
+
 } // namespace util
@@ -3,6 +3,7 @@
 #include "nd_methods/FastestDescent.h"
 #include "sd_methods/Brent.h"
 #include "util/Function.h"
+#include "util/Instrument.h"
 #include "util/Misc.h"
 #include "util/ReplayData.h"
 #include "util/VectorOps.h"
@@ -55,7 +56,7 @@ std::string format_for_matlab(const util::ReplayData & replay_data, const Functi
         [](const auto &) {}
     );
 
-    std::for_each(replay_data.begin(), replay_data.end(), [&](const auto & part) { part->call_func(collect_points); });
+    std::for_each(replay_data.begin(), replay_data.end(), [&](const auto & part) { part.call_func(collect_points); });
 
     std::stringstream ss;
     print(ss << "a = ", x) << ";\n";
@@ -70,6 +71,7 @@ std::string format_for_matlab(const util::ReplayData & replay_data, const Functi
     ss << "[X,Y] = meshgrid(x,y);\n";
 
     auto func_for_matlab = util::replace_all(as_string(func), " ^ ", ".^");
+    func_for_matlab = util::replace_all(std::move(func_for_matlab), " / ", "./");
     func_for_matlab = util::replace_all(std::move(func_for_matlab), "x0", "X");
     func_for_matlab = util::replace_all(std::move(func_for_matlab), "x1", "Y");
     ss << "Z = " << func_for_matlab << ";\n";
@@ -88,7 +90,7 @@ std::ostream & print(std::ostream & out, const util::ReplayData & replay_data)
     );
 
     for (const auto & part : replay_data) {
-        part->call_func(to_out);
+        part.call_func(to_out);
     }
     return out;
 }
@@ -100,6 +102,9 @@ void count_and_print_newton(NewtonMethods & newtone, const Function & func, cons
         print(std::cout, res) << "\n";
 
         std::cout << "For matlab:\n\n" << format_for_matlab(newtone.replay_data(), func) << "\n\n";
+        if constexpr (util::InstrumentEnabled) {
+            std::cout << newtone.stats() << '\n';
+        }
     };
 
     std::cout << "Classic:\n";
@@ -122,6 +127,9 @@ void count_and_print_quasi(const Function & func, const std::vector<double> & in
         std::cout << "f(x) = " << qn.last_func()(res) << "\n\n";
 
         std::cout << "For matlab:\n\n" << format_for_matlab(qn.replay_data(), func) << "\n\n";
+        if constexpr (util::InstrumentEnabled) {
+            std::cout << qn.stats() << '\n';
+        }
     };
 
     std::cout << "Broyder-Fletcher-Sheno:\n";
@@ -139,6 +147,9 @@ void count_and_print_fast_desc(min_nd::FastestDescent & fd, const Function & fun
         std::cout << "f(x) = " << fd.last_func()(res) << "\n\n";
 
         std::cout << "For matlab:\n\n" << format_for_matlab(fd.replay_data(), func) << "\n\n";
+        if constexpr (util::InstrumentEnabled) {
+            std::cout << fd.stats() << '\n';
+        }
     };
 
     std::cout << "Fastest descend:\n";
@@ -0,0 +1,432 @@
+#include "methods/BatchedSearcher.h"
+
+#include "util/Arena.h"
+#include "util/Instrument.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+// out[k] = sum of a[i * m + k] * b[i * m + k] over "rows"
+void dot_lanes(const double * a, const double * b, unsigned rows, std::size_t m, double * out)
+{
+    std::fill_n(out, m, 0.);
+    for (unsigned i = 0; i < rows; ++i) {
+        const double * a_row = a + i * m;
+        const double * b_row = b + i * m;
+#pragma omp simd
+        for (std::size_t k = 0; k < m; ++k) {
+            out[k] += a_row[k] * b_row[k];
+        }
+    }
+}
+
+/*
+ * Solve "m" systems a x = b at once, a is n x n x m, b is n x m, answer is written to "b".
+ * Gaussian elimination without pivoting, so every step is the same for all systems:
+ * zero pivot gives infinite or NaN answer, which is rejected as non-descent direction.
+ * The least pivot of every system is written to "min_pivot": symmetric matrix is
+ * positive definite iff all its pivots are positive.
+ */
+void solve_lanes(double * a, double * b, unsigned n, std::size_t m, double * factor, double * min_pivot)
+{
+    auto at = [&](unsigned row, unsigned col) { return a + (row * n + col) * m; };
+
+    std::fill_n(min_pivot, m, std::numeric_limits<double>::infinity());
+    for (unsigned k = 0; k < n; ++k) {
+        const double * pivot = at(k, k);
+        const double * b_k = b + k * m;
+#pragma omp simd
+        for (std::size_t l = 0; l < m; ++l) {
+            min_pivot[l] = pivot[l] > min_pivot[l] ? min_pivot[l] : pivot[l];
+        }
+        for (unsigned i = k + 1; i < n; ++i) {
+            const double * lead = at(i, k);
+#pragma omp simd
+            for (std::size_t l = 0; l < m; ++l) {
+                factor[l] = lead[l] / pivot[l];
+            }
+            for (unsigned j = k + 1; j < n; ++j) {
+                double * dst = at(i, j);
+                const double * src = at(k, j);
+#pragma omp simd
+                for (std::size_t l = 0; l < m; ++l) {
+                    dst[l] -= factor[l] * src[l];
+                }
+            }
+            double * b_i = b + i * m;
+#pragma omp simd
+            for (std::size_t l = 0; l < m; ++l) {
+                b_i[l] -= factor[l] * b_k[l];
+            }
+        }
+    }
+
+    for (unsigned k = n; k-- > 0;) {
+        double * b_k = b + k * m;
+        for (unsigned j = k + 1; j < n; ++j) {
+            const double * a_kj = at(k, j);
+            const double * b_j = b + j * m;
+#pragma omp simd
+            for (std::size_t l = 0; l < m; ++l) {
+                b_k[l] -= a_kj[l] * b_j[l];
+            }
+        }
+        const double * pivot = at(k, k);
+#pragma omp simd
+        for (std::size_t l = 0; l < m; ++l) {
+            b_k[l] /= pivot[l];
+        }
+    }
+}
+
+// Hessian by the first "vars" variables, rows are differentiated separately
+Func<2> partial_hessian(const Func<1> & grad, unsigned vars)
+{
+    std::vector<Func<1>> rows;
+    rows.reserve(vars);
+    for (unsigned i = 0; i < vars; ++i) {
+        rows.push_back(grad[i].partial_grad(vars));
+    }
+    return Func<2>(std::move(rows));
+}
+
+} // anonymous namespace
+
+std::size_t BatchedSearcher::Result::converged(double grad_norm) const noexcept
+{
+    std::size_t res = 0;
+    for (std::size_t k = 0; k < reasons.size(); ++k) {
+        res += reasons[k] == util::StopReason::GradientNorm
+            || (reasons[k] == util::StopReason::StepSize && grad_norms[k] < grad_norm);
+    }
+    return res;
+}
+
+BatchedSearcher::BatchedSearcher(double eps, Method method)
+    : m_method(method)
+{
+    m_criteria.step = eps;
+    m_criteria.max_iterations = MaxIter;
+}
+
+std::string_view BatchedSearcher::method_name() const noexcept
+{
+    switch (m_method) {
+        case Method::Newton: return "Batched Newton";
+        case Method::BFGS: return "Batched Broyden-Fletcher-Shanno";
+    }
+    return "";
+}
+
+auto BatchedSearcher::minimize(const Function & func, util::VectorT & xs, std::size_t count, unsigned vars) -> Result
+{
+    const unsigned dims = func.dims();
+    vars = vars != 0 ? vars : dims;
+    assert(vars <= dims && "Function has fewer variables");
+    assert(xs.size() == dims * count && "Points don't match function's dimension");
+
+    Result res;
+    res.values.assign(count, 0.);
+    res.grad_norms.assign(count, 0.);
+    res.iterations.assign(count, 0);
+    res.reasons.assign(count, util::StopReason::None);
+
+    // Derivatives are built once for the whole batch
+    util::Arena arena;
+    Func<1> grad;
+    Func<2> hessian;
+    {
+        Fn::ArenaScope scope(arena);
+        grad = func.partial_grad(vars);
+        if (m_method == Method::Newton) {
+            hessian = partial_hessian(grad, vars);
+        }
+    }
+
+    std::size_t active = count;
+    m_problems.resize(count);
+    std::iota(m_problems.begin(), m_problems.end(), std::size_t{0});
+    m_x = xs;
+    m_values.resize(active);
+    m_grad.resize(vars * active);
+    m_step.assign(active, std::numeric_limits<double>::infinity());
+    {
+        util::PhaseTimer timer(util::Phase::Func);
+        func.eval_batch(m_x.data(), active, m_values.data());
+    }
+    {
+        util::PhaseTimer timer(util::Phase::Grad);
+        grad.eval_batch(m_x.data(), active, m_grad.data());
+    }
+    if (m_method == Method::BFGS) {
+        // Every anti-hessian starts as identity
+        m_matrix.assign(vars * vars * active, 0.);
+        for (unsigned i = 0; i < vars; ++i) {
+            std::fill_n(m_matrix.data() + (i * vars + i) * active, active, 1.);
+        }
+    }
+
+    std::vector<std::size_t> keep;
+    keep.reserve(count);
+    for (unsigned iter_num = 0; active > 0; ++iter_num) {
+        // Stopped problems leave the batch with their results
+        m_lane.resize(active);
+        dot_lanes(m_grad.data(), m_grad.data(), vars, active, m_lane.data());
+        keep.clear();
+        for (std::size_t k = 0; k < active; ++k) {
+            auto reason = util::progress_reason(m_criteria, m_step[k], std::sqrt(m_lane[k]));
+            if (reason == util::StopReason::StepSize && m_step[k] < 0.) {
+                reason = util::StopReason::LineSearchFailed;
+            }
+            if (reason == util::StopReason::None && m_criteria.max_iterations != 0 && iter_num >= m_criteria.max_iterations) {
+                reason = util::StopReason::MaxIterations;
+            }
+            if (reason == util::StopReason::None) {
+                keep.push_back(k);
+                continue;
+            }
+
+            std::size_t problem = m_problems[k];
+            res.values[problem] = m_values[k];
+            res.grad_norms[problem] = std::sqrt(m_lane[k]);
+            res.iterations[problem] = iter_num;
+            res.reasons[problem] = reason;
+            for (unsigned i = 0; i < dims; ++i) {
+                xs[i * count + problem] = m_x[i * active + k];
+            }
+        }
+        if (keep.size() != active) {
+            compact(keep, active, dims, vars);
+            active = keep.size();
+        }
+        if (active == 0) {
+            break;
+        }
+
+        count_directions(hessian, active, vars);
+        line_search(func, active, dims, vars);
+        {
+            util::PhaseTimer timer(util::Phase::Grad);
+            m_next_grad.resize(vars * active);
+            grad.eval_batch(m_x.data(), active, m_next_grad.data());
+        }
+        if (m_method == Method::BFGS) {
+            update_anti_hessians(active, vars);
+        }
+        std::swap(m_grad, m_next_grad);
+    }
+
+    return res;
+}
+
+void BatchedSearcher::count_directions(const Func<2> & hessian, std::size_t active, unsigned vars)
+{
+    m_dir.resize(vars * active);
+    switch (m_method) {
+    case Method::Newton: {
+        {
+            util::PhaseTimer timer(util::Phase::Hessian);
+            m_matrix.resize(vars * vars * active);
+            hessian.eval_batch(m_x.data(), active, m_matrix.data());
+        }
+        util::PhaseTimer timer(util::Phase::LinearSolve);
+        std::transform(m_grad.begin(), m_grad.end(), m_dir.begin(), [](double g) { return -g; });
+        m_lane.resize(active);
+        m_lane_aux.resize(active);
+        solve_lanes(m_matrix.data(), m_dir.data(), vars, active, m_lane.data(), m_lane_aux.data());
+        // Direction of indefinite hessian may lead to saddle point even with descent derivative
+        for (unsigned i = 0; i < vars; ++i) {
+            double * dir = m_dir.data() + i * active;
+#pragma omp simd
+            for (std::size_t k = 0; k < active; ++k) {
+                dir[k] = m_lane_aux[k] > 0. ? dir[k] : 0.;
+            }
+        }
+        break;
+    }
+    case Method::BFGS: {
+        util::PhaseTimer timer(util::Phase::Update);
+        std::fill(m_dir.begin(), m_dir.end(), 0.);
+        for (unsigned i = 0; i < vars; ++i) {
+            double * dir = m_dir.data() + i * active;
+            for (unsigned j = 0; j < vars; ++j) {
+                const double * h = m_matrix.data() + (i * vars + j) * active;
+                const double * g = m_grad.data() + j * active;
+#pragma omp simd
+                for (std::size_t k = 0; k < active; ++k) {
+                    dir[k] -= h[k] * g[k];
+                }
+            }
+        }
+        break;
+    }
+    }
+
+    // If direction is not the descent one (or solve failed), antigradient is used instead
+    m_der.resize(active);
+    m_lane.resize(active);
+    dot_lanes(m_grad.data(), m_dir.data(), vars, active, m_der.data());
+    dot_lanes(m_grad.data(), m_grad.data(), vars, active, m_lane.data());
+    for (unsigned i = 0; i < vars; ++i) {
+        double * dir = m_dir.data() + i * active;
+        const double * g = m_grad.data() + i * active;
+#pragma omp simd
+        for (std::size_t k = 0; k < active; ++k) {
+            dir[k] = m_der[k] < 0. ? dir[k] : -g[k];
+        }
+    }
+#pragma omp simd
+    for (std::size_t k = 0; k < active; ++k) {
+        m_der[k] = m_der[k] < 0. ? m_der[k] : -m_lane[k];
+    }
+}
+
+void BatchedSearcher::line_search(const Function & func, std::size_t active, unsigned dims, unsigned vars)
+{
+    util::PhaseTimer timer(util::Phase::LineSearch);
+
+    // m_lane marks problems, which accepted their step
+    m_alpha.assign(active, 1.);
+    m_lane.assign(active, 0.);
+    m_trial.resize(dims * active);
+    m_trial_values.resize(active);
+    // parameters don't change
+    std::copy(m_x.begin() + vars * active, m_x.begin() + dims * active, m_trial.begin() + vars * active);
+
+    for (unsigned round = 0; round < MaxBacktracks; ++round) {
+        for (unsigned i = 0; i < vars; ++i) {
+            const double * x = m_x.data() + i * active;
+            const double * dir = m_dir.data() + i * active;
+            double * trial = m_trial.data() + i * active;
+#pragma omp simd
+            for (std::size_t k = 0; k < active; ++k) {
+                trial[k] = x[k] + m_alpha[k] * dir[k];
+            }
+        }
+        {
+            util::PhaseTimer timer(util::Phase::Func);
+            func.eval_batch(m_trial.data(), active, m_trial_values.data());
+        }
+
+        // Armijo rule, step of problem, which didn't decrease enough, is halved
+        std::size_t pending = 0;
+#pragma omp simd reduction(+ : pending)
+        for (std::size_t k = 0; k < active; ++k) {
+            bool accepted = m_lane[k] != 0. || m_trial_values[k] <= m_values[k] + ArmijoRatio * m_alpha[k] * m_der[k];
+            m_lane[k] = accepted;
+            m_alpha[k] = accepted ? m_alpha[k] : 0.5 * m_alpha[k];
+            pending += !accepted;
+        }
+        if (pending == 0) {
+            break;
+        }
+    }
+
+    // Problems without accepted step stay in place, their negative step stops them as failed
+    m_lane_aux.resize(active);
+    dot_lanes(m_dir.data(), m_dir.data(), vars, active, m_lane_aux.data());
+#pragma omp simd
+    for (std::size_t k = 0; k < active; ++k) {
+        m_alpha[k] = m_lane[k] != 0. ? m_alpha[k] : 0.;
+        m_values[k] = m_lane[k] != 0. ? m_trial_values[k] : m_values[k];
+        m_step[k] = m_lane[k] != 0. ? m_alpha[k] * std::sqrt(m_lane_aux[k]) : -1.;
+    }
+    for (unsigned i = 0; i < vars; ++i) {
+        double * x = m_x.data() + i * active;
+        const double * dir = m_dir.data() + i * active;
+#pragma omp simd
+        for (std::size_t k = 0; k < active; ++k) {
+            x[k] += m_alpha[k] * dir[k];
+        }
+    }
+}
+
+/*
+ * H' = H + (s * y + y * H * y) / (s * y)^2 s s^T - (H y s^T + s y^T H) / (s * y),
+ * s = alpha * d is the step, y is the difference of gradients.
+ * Update is skipped, if s * y <= 0, so anti-hessians stay positive definite.
+ */
+void BatchedSearcher::update_anti_hessians(std::size_t active, unsigned vars)
+{
+    util::PhaseTimer timer(util::Phase::Update);
+
+    // m_dir becomes the step
+    for (unsigned i = 0; i < vars; ++i) {
+        double * dir = m_dir.data() + i * active;
+#pragma omp simd
+        for (std::size_t k = 0; k < active; ++k) {
+            dir[k] *= m_alpha[k];
+        }
+    }
+    m_grad_diff.resize(vars * active);
+    std::transform(m_next_grad.begin(), m_next_grad.end(), m_grad.begin(), m_grad_diff.begin(), std::minus<>{});
+
+    m_product.assign(vars * active, 0.);
+    for (unsigned i = 0; i < vars; ++i) {
+        double * hy = m_product.data() + i * active;
+        for (unsigned j = 0; j < vars; ++j) {
+            const double * h = m_matrix.data() + (i * vars + j) * active;
+            const double * y = m_grad_diff.data() + j * active;
+#pragma omp simd
+            for (std::size_t k = 0; k < active; ++k) {
+                hy[k] += h[k] * y[k];
+            }
+        }
+    }
+
+    // m_lane is 1 / (s * y), m_lane_aux is coefficient of s s^T
+    m_lane.resize(active);
+    m_lane_aux.resize(active);
+    dot_lanes(m_dir.data(), m_grad_diff.data(), vars, active, m_lane.data());
+    dot_lanes(m_grad_diff.data(), m_product.data(), vars, active, m_lane_aux.data());
+#pragma omp simd
+    for (std::size_t k = 0; k < active; ++k) {
+        double sy = m_lane[k];
+        double rho = sy > 0. ? 1. / sy : 0.;
+        m_lane[k] = rho;
+        m_lane_aux[k] = (sy + m_lane_aux[k]) * rho * rho;
+    }
+
+    for (unsigned i = 0; i < vars; ++i) {
+        const double * s_i = m_dir.data() + i * active;
+        const double * hy_i = m_product.data() + i * active;
+        for (unsigned j = 0; j < vars; ++j) {
+            const double * s_j = m_dir.data() + j * active;
+            const double * hy_j = m_product.data() + j * active;
+            double * h = m_matrix.data() + (i * vars + j) * active;
+#pragma omp simd
+            for (std::size_t k = 0; k < active; ++k) {
+                h[k] += m_lane_aux[k] * s_i[k] * s_j[k] - m_lane[k] * (hy_i[k] * s_j[k] + s_i[k] * hy_j[k]);
+            }
+        }
+    }
+}
+
+void BatchedSearcher::compact(const std::vector<std::size_t> & keep, std::size_t active, unsigned dims, unsigned vars)
+{
+    // Rows shrink in place: every kept value moves to a lower or the same index
+    auto shrink = [&](auto & buf, std::size_t rows) {
+        for (std::size_t i = 0; i < rows; ++i) {
+            for (std::size_t j = 0; j < keep.size(); ++j) {
+                buf[i * keep.size() + j] = buf[i * active + keep[j]];
+            }
+        }
+        buf.resize(rows * keep.size());
+    };
+
+    shrink(m_problems, 1);
+    shrink(m_x, dims);
+    shrink(m_values, 1);
+    shrink(m_grad, vars);
+    shrink(m_step, 1);
+    if (m_method == Method::BFGS) {
+        shrink(m_matrix, vars * vars);
+    }
+}
@@ -3,56 +3,165 @@
 #include "sd_methods/Brent.h"
 #include "sole-solver/QuadMatrix.h"
 #include "sole-solver/Solver.h"
+#include "util/Arena.h"
+#include "util/FixedOps.h"
+#include "util/Instrument.h"
+#include "util/Tape.h"
 #include "util/VectorOps.h"
 #include "util/VersionedData.h"
 
+#include <cmath>
 #include <functional>
 #include <iostream>
 #include <type_traits>
+#include <utility>
 
-std::vector<double> NewtonMethods::classic(const Function & func, std::vector<double> init)
+namespace {
+
+// Gradient and hessian as expression trees, or the tape evaluating them all by one run
+struct Derivatives
+{
+    const util::Tape * tape;
+    Func<1> grad;
+    Func<2> hessian;
+};
+
+// Build gradient and hessian with all their nodes allocated from "arena", unless function is backed by tape
+Derivatives build_derivatives(const Function & func, util::Arena & arena)
+{
+    if (const auto * tape = util::Tape::backing(func)) {
+        return {tape, Func<1>(), Func<2>()};
+    }
+    Fn::ArenaScope scope(arena);
+    auto grad = func.grad();
+    auto hessian = grad.grad();
+    return {nullptr, std::move(grad), std::move(hessian)};
+}
+
+/*
+ * Buffer for hessian's values: flat row-major array for small dimensions,
+ * which are solved by fixed-size code (see util/FixedOps.h), matrix for the rest
+ */
+struct HessianValues
+{
+    explicit HessianValues(unsigned dims)
+        : dims(dims)
+        , flat(is_small(dims) ? dims * dims : 0)
+        , matrix(is_small(dims) ? 0 : dims, is_small(dims) ? 0 : dims)
+    {}
+
+    static bool is_small(unsigned dims) noexcept { return dims <= util::fixed::MaxDims; }
+
+    unsigned dims;
+    util::VectorT flat;
+    QuadMatrix matrix;
+};
+
+// Evaluate gradient and hessian into reused buffers
+void eval_derivatives(const Derivatives & derivatives, const util::VectorT & x, util::VectorT & grad_out, HessianValues & hessian_out)
+{
+    const auto & [tape, grad, hessian] = derivatives;
+    if (tape != nullptr) {
+        {
+            util::PhaseTimer timer(util::Phase::Grad);
+            tape->eval(x, grad_out);
+        }
+        // continues the run of the gradient
+        util::PhaseTimer timer(util::Phase::Hessian);
+        if (HessianValues::is_small(hessian_out.dims)) {
+            tape->eval_hessian(x, hessian_out.flat.data());
+        } else {
+            tape->eval_hessian(x, hessian_out.matrix);
+        }
+        return;
+    }
+    {
+        util::PhaseTimer timer(util::Phase::Grad);
+        grad.eval_into(x, grad_out);
+    }
+    util::PhaseTimer timer(util::Phase::Hessian);
+    if (HessianValues::is_small(hessian_out.dims)) {
+        hessian.eval_into(x, hessian_out.flat.data());
+    } else {
+        hessian.eval_into(x, hessian_out.matrix);
+    }
+}
+
+// Solve the newton system for the shift
+Solver::Result solve_shift(HessianValues & a, std::vector<double> && b)
+{
+    util::PhaseTimer timer(util::Phase::LinearSolve);
+    bool fixed = util::fixed::dispatch(a.dims, [&](auto dims) {
+        constexpr unsigned N = decltype(dims)::value;
+        auto answer = util::fixed::to_vec<N>(b);
+        util::fixed::solve_lu<N>(util::fixed::to_mat<N>(a.flat.data()), answer);
+        util::fixed::store<N>(answer, b);
+    });
+    if (fixed) {
+        // the same count of multiplications and divisions as in Solver::solve_lu
+        return {std::move(b), a.dims * a.dims};
+    }
+    // (hessian is decomposed in-place by solver, it's refilled on the next iteration)
+    return Solver::solve_lu(std::move(a.matrix), std::move(b));
+}
+
+} // anonymous namespace
+
+template <class Trace>
+std::vector<double> BasicNewtonMethods<Trace>::classic(const Function & func, std::vector<double> init)
 {
     // Init
     auto curr = init_method(func, std::move(init));
-    auto eps_2 = m_eps * m_eps;
 
     // Count initial hessian and gradient
-    auto grad = func.grad();
-    auto hessian = grad.grad();
+    util::Arena arena;
+    auto derivatives = build_derivatives(func, arena);
 
-    // End if max iterations treshold is reached
-    for (unsigned iter_num = 0; iter_num < MaxIter; ++iter_num) {
+    // Buffers for derivatives' values, reused between iterations
+    util::VectorT curr_grad(func.dims());
+    HessianValues curr_hessian(func.dims());
+
+    // End if iterations, evaluations or time limit is reached
+    for (unsigned iter_num = 0; !m_termination.stop_on_limits(iter_num); ++iter_num) {
         log_x(iter_num, curr);
 
         // Solve sole to find p_k
-        auto shift = Solver::solve_lu(QuadMatrix(hessian(curr)), util::neg(grad(curr)));
+        eval_derivatives(derivatives, curr, curr_grad, curr_hessian);
+        auto shift = solve_shift(curr_hessian, util::neg(curr_grad));
 
-        auto shift_len = util::length(shift.answer);
-        if (shift_len < eps_2) {
+        if (m_termination.stop_on_progress(std::sqrt(util::length(shift.answer)), std::sqrt(util::length(curr_grad)))) {
             // end iterating if we got enough precision
             break;
         } else {
             // count next point
             curr = util::add(std::move(curr), std::move(shift.answer));
         }
+        m_stats.next_iteration();
     }
+    m_stats.finish();
+    save_state(curr);
     return curr;
 }
 
-std::vector<double> NewtonMethods::with_sd_search(const Function & func, std::vector<double> init)
+template <class Trace>
+std::vector<double> BasicNewtonMethods<Trace>::with_sd_search(const Function & func, std::vector<double> init)
 {
     // Init
     auto curr = init_method(func, std::move(init));
-    auto eps_2 = m_eps * m_eps;
 
     // Count initial hessian and gradient
-    auto grad = func.grad();
-    auto hessian = grad.grad();
+    util::Arena arena;
+    auto derivatives = build_derivatives(func, arena);
 
-    // End if max iterations treshold is reached
-    for (unsigned iter_num = 0; iter_num < MaxIter; ++iter_num) {
+    // Buffers for derivatives' values, reused between iterations
+    util::VectorT curr_grad(func.dims());
+    HessianValues curr_hessian(func.dims());
+
+    // End if iterations, evaluations or time limit is reached
+    for (unsigned iter_num = 0; !m_termination.stop_on_limits(iter_num); ++iter_num) {
         // Solve sole to find p_k
-        auto shift = Solver::solve_lu(QuadMatrix(hessian(curr)), util::neg(grad(curr)));
+        eval_derivatives(derivatives, curr, curr_grad, curr_hessian);
+        auto shift = solve_shift(curr_hessian, util::neg(curr_grad));
 
         // Find coefficient alpha by solving one-dimensional minimization problem
         auto alpha = find_alpha(curr, shift.answer);
@@ -62,36 +171,43 @@ std::vector<double> NewtonMethods::with_sd_search(const Function & func, std::ve
 
         // Count the next step
         shift.answer = util::mul(std::move(shift.answer), alpha);
-        if (util::length(shift.answer) < eps_2) {
+        if (m_termination.stop_on_progress(std::sqrt(util::length(shift.answer)), std::sqrt(util::length(curr_grad)))) {
             // end iterating if we got enough precision
             break;
         } else {
             // count the next point
             curr = util::add(std::move(curr), std::move(shift.answer));
         }
+        m_stats.next_iteration();
     }
+    m_stats.finish();
+    save_state(curr);
 
     return curr;
 }
 
-std::vector<double> NewtonMethods::with_desc_dir(const Function & func, std::vector<double> init)
+template <class Trace>
+std::vector<double> BasicNewtonMethods<Trace>::with_desc_dir(const Function & func, std::vector<double> init)
 {
     // Init
     auto curr = init_method(func, std::move(init));
-    auto eps_2 = m_eps * m_eps;
 
     // Count initial hessian and gradient
-    auto grad = func.grad();
-    auto hessian = grad.grad();
+    util::Arena arena;
+    auto derivatives = build_derivatives(func, arena);
+
+    // Buffers for derivatives' values, reused between iterations
+    util::VectorT curr_grad(func.dims());
+    HessianValues curr_hessian(func.dims());
 
-    // End if max iterations treshold is reached
-    for (unsigned iter_num = 0; iter_num < MaxIter; ++iter_num) {
+    // End if iterations, evaluations or time limit is reached
+    for (unsigned iter_num = 0; !m_termination.stop_on_limits(iter_num); ++iter_num) {
         // Count current gradient and antigradient
-        auto curr_grad = grad(curr);
+        eval_derivatives(derivatives, curr, curr_grad, curr_hessian);
         auto curr_grad_neg = util::neg(curr_grad);
 
         // Solve sole to find p_k
-        auto shift = Solver::solve_lu(QuadMatrix(hessian(curr)), std::vector(curr_grad_neg));
+        auto shift = solve_shift(curr_hessian, std::vector(curr_grad_neg));
 
         // if current direction is not the descent direction, use antigradient instead
         if (util::scalar(shift.answer, curr_grad) > 0) {
@@ -106,14 +222,43 @@ std::vector<double> NewtonMethods::with_desc_dir(const Function & func, std::vec
 
         // Count the next step
         shift.answer = util::mul(std::move(shift.answer), alpha);
-        if (util::length(shift.answer) < eps_2) {
+        if (m_termination.stop_on_progress(std::sqrt(util::length(shift.answer)), std::sqrt(util::length(curr_grad)))) {
             // end iterating if we got enough precision
             break;
         } else {
             // count the next point
             curr = util::add(std::move(curr), std::move(shift.answer));
         }
+        m_stats.next_iteration();
     }
+    m_stats.finish();
+    save_state(curr);
 
     return curr;
 }
+
+template <class Trace>
+std::string_view BasicNewtonMethods<Trace>::method_name() const noexcept
+{
+    switch (m_variant) {
+        case Variant::Classic: return "Newton";
+        case Variant::SdSearch: return "Newton with one-dimensional search";
+        case Variant::DescDir: return "Newton with descent direction choice";
+    }
+    return "";
+}
+
+template <class Trace>
+util::VectorT BasicNewtonMethods<Trace>::minimize_impl(const Function & func, util::VectorT init)
+{
+    switch (m_variant) {
+        case Variant::Classic: return classic(func, std::move(init));
+        case Variant::SdSearch: return with_sd_search(func, std::move(init));
+        case Variant::DescDir: break;
+    }
+    return with_desc_dir(func, std::move(init));
+}
+
+template struct BasicNewtonMethods<util::FullTrace>;
+template struct BasicNewtonMethods<util::NoTrace>;
+template struct BasicNewtonMethods<util::SampledTrace>;
@@ -1,7 +1,12 @@
 #include "methods/QuasiNewton.h"
 #include "sd_methods/Brent.h"
 #include "sole-solver/QuadMatrix.h"
+#include "util/Arena.h"
+#include "util/FixedOps.h"
+#include "util/Instrument.h"
+#include "util/Tape.h"
 #include "util/VectorOps.h"
+#include <cmath>
 #include <functional>
 
 
@@ -23,8 +28,20 @@ MatrixT identity_matrix(unsigned dims)
 }
 
 // Count next anti-hessian with Broyden-Fletcher-Shanno algorithm
-MatrixT QuasiNewton::bfs(MatrixT ah, VectorT w_diff, const VectorT & curr_diff)
+template <class Trace>
+MatrixT BasicQuasiNewton<Trace>::bfs(MatrixT ah, VectorT w_diff, const VectorT & curr_diff)
 {
+    // Small dimensions are updated in place by fixed-size code
+    bool fixed = util::fixed::dispatch(ah.size(), [&](auto dims) {
+        constexpr unsigned N = decltype(dims)::value;
+        auto mat = util::fixed::to_mat<N>(ah);
+        util::fixed::bfs_update<N>(mat, util::fixed::to_vec<N>(w_diff), util::fixed::to_vec<N>(curr_diff));
+        util::fixed::store<N>(mat, ah);
+    });
+    if (fixed) {
+        return ah;
+    }
+
     VectorT ah_wd = util::mul(ah, w_diff);
     double roe = util::scalar(ah_wd, w_diff);
     double wd_cd = util::scalar(w_diff, curr_diff);
@@ -43,8 +60,19 @@ MatrixT QuasiNewton::bfs(MatrixT ah, VectorT w_diff, const VectorT & curr_diff)
 }
 
 // Count next anti-hessian with powell algorithm
-util::MatrixT QuasiNewton::powell(util::MatrixT ah, util::VectorT w_diff, const util::VectorT & x_diff)
+template <class Trace>
+util::MatrixT BasicQuasiNewton<Trace>::powell(util::MatrixT ah, util::VectorT w_diff, const util::VectorT & x_diff)
 {
+    bool fixed = util::fixed::dispatch(ah.size(), [&](auto dims) {
+        constexpr unsigned N = decltype(dims)::value;
+        auto mat = util::fixed::to_mat<N>(ah);
+        util::fixed::powell_update<N>(mat, util::fixed::to_vec<N>(w_diff), util::fixed::to_vec<N>(x_diff));
+        util::fixed::store<N>(mat, ah);
+    });
+    if (fixed) {
+        return ah;
+    }
+
     VectorT x_wave = util::add(util::mul(ah, w_diff), x_diff);
 
     return util::sub(
@@ -52,16 +80,17 @@ util::MatrixT QuasiNewton::powell(util::MatrixT ah, util::VectorT w_diff, const
         util::mul(util::mul(x_wave, x_wave), 1. / util::scalar(w_diff, x_wave)));
 }
 
-auto QuasiNewton::search_common(UpdateRule rule, const Function &func, PointT init) -> PointT
+template <class Trace>
+auto BasicQuasiNewton<Trace>::search_common(UpdateRule rule, const Function &func, PointT init) -> PointT
 {
     // choose current algorithm
-    decltype(&QuasiNewton::bfs) next_anti_hessian_method;
+    decltype(&BasicQuasiNewton::bfs) next_anti_hessian_method;
     switch (rule) {
         case UpdateRule::BFSh:
-            next_anti_hessian_method = &QuasiNewton::bfs;
+            next_anti_hessian_method = &BasicQuasiNewton::bfs;
             break;
         case UpdateRule::Powell:
-            next_anti_hessian_method = &QuasiNewton::powell;
+            next_anti_hessian_method = &BasicQuasiNewton::powell;
             break;
     }
 
@@ -69,45 +98,85 @@ auto QuasiNewton::search_common(UpdateRule rule, const Function &func, PointT in
     using namespace std::placeholders;
     auto next_anti_hessian = std::bind(next_anti_hessian_method, this, _1, _2, _3);
 
-    double eps_2 = m_eps * m_eps;
-
     PointT curr = init_method(func, std::move(init));
     VectorT curr_diff, w;
 
     unsigned iter_num = 0;
     log_x(iter_num++, curr);
 
-    auto grad = func.grad();
-    MatrixT anti_hessian = identity_matrix(func.dims());
+    util::Arena arena;
+    // function backed by tape evaluates its gradient by one run of the tape
+    const util::Tape * tape = util::Tape::backing(func);
+    auto grad = [&] { Fn::ArenaScope scope(arena); return tape != nullptr ? Func<1>() : func.grad(); }();
+    // Warm start continues with the previous curvature estimate
+    auto warm = warm_state(func.dims());
+    MatrixT anti_hessian = warm != nullptr && !warm->curvature.empty() ? warm->curvature : identity_matrix(func.dims());
+
+    // Evaluate antigradient in point x
+    auto antigrad = [&grad, tape](const PointT & x) {
+        util::PhaseTimer timer(util::Phase::Grad);
+        if (tape != nullptr) {
+            VectorT res;
+            tape->eval(x, res);
+            return util::neg(std::move(res));
+        }
+        return util::neg(grad(x));
+    };
 
     // Count first iteration
     {
-        w = util::neg(grad(curr));
-        VectorT p = w;
-        double alpha = find_alpha(curr, p);
+        w = antigrad(curr);
+        VectorT p = util::mul(anti_hessian, w);
+        double alpha = find_exact_alpha(curr, p);
         curr_diff = util::mul(std::move(p), alpha);
         curr = util::add(std::move(curr), curr_diff);
         log_x(iter_num++, curr);
+        m_stats.next_iteration();
     }
 
-    do {
-        // Count next vector w
-        VectorT next_w = util::neg(grad(curr));
+    // Do until required precision is reached or limits are exhausted
+    while (!m_termination.stop_on_progress(std::sqrt(util::length(curr_diff))) && !m_termination.stop_on_limits(iter_num - 1)) {
+        // Count next vector w, stop if gradient is small enough
+        VectorT next_w = antigrad(curr);
+        if (m_termination.stop_on_progress(std::sqrt(util::length(curr_diff)), std::sqrt(util::length(next_w)))) {
+            break;
+        }
         VectorT w_diff = util::sub(next_w, std::move(w));
         w = std::move(next_w);
 
         // Count next anti-hessian matrix
-        anti_hessian = next_anti_hessian(std::move(anti_hessian), std::move(w_diff), curr_diff);
+        {
+            util::PhaseTimer timer(util::Phase::Update);
+            anti_hessian = next_anti_hessian(std::move(anti_hessian), std::move(w_diff), curr_diff);
+        }
 
         // Count next step and alpha coefficient
+        // (updates of anti-hessian rely on exact line search, so the whole segment is searched with full precision)
         VectorT p = util::mul(anti_hessian, w);
-        double alpha = find_alpha(curr, p);
+        double alpha = find_exact_alpha(curr, p);
 
         // Count next point
         curr_diff = util::mul(std::move(p), alpha);
         curr = util::add(std::move(curr), curr_diff);
         log_x(iter_num++, curr);
-    } while(util::length(curr_diff) > eps_2);       // Do until required precision is reached
+        m_stats.next_iteration();
+    }
+    m_stats.finish();
+    save_state(curr, std::move(anti_hessian));
 
     return curr;
 }
+
+template <class Trace>
+std::string_view BasicQuasiNewton<Trace>::method_name() const noexcept
+{
+    switch (m_rule) {
+        case UpdateRule::BFSh: return "Broyden-Fletcher-Shanno";
+        case UpdateRule::Powell: return "Powell";
+    }
+    return "";
+}
+
+template struct BasicQuasiNewton<util::FullTrace>;
+template struct BasicQuasiNewton<util::NoTrace>;
+template struct BasicQuasiNewton<util::SampledTrace>;
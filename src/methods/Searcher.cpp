@@ -4,33 +4,99 @@
 #include "util/VectorOps.h"
 
 
-auto Searcher::init_method(const Function & func, std::vector<double> init) -> PointT
+template <class Trace>
+auto Searcher<Trace>::init_method(const Function & func, std::vector<double> init) -> PointT
 {
     m_last_func = &func;
     m_replay_data.clear();
+    m_stats.start();
+    m_termination.start(m_criteria);
+    m_bracketing.reset();
 
-    if (init.empty()) {
-        return std::vector<double>(func.dims(), 0.);
-    } else {
-        return std::move(init);
+    if (auto warm = warm_state(func.dims())) {
+        m_bracketing.accept(warm->step, warm->der);
     }
+    return initial_point(func.dims(), std::move(init));
 }
 
-double Searcher::find_alpha(const PointT & curr, const std::vector<double> & shift)
+template <class Trace>
+void Searcher<Trace>::save_state(const PointT & curr, util::MatrixT curvature)
 {
-    return m_sd_searcher.find_min(min1d::Function(
-        [&](double x) { return last_func()(util::add(curr, util::mul(shift, x))); },
-        {0.0, 10}));
+    m_state.point = curr;
+    m_state.curvature = std::move(curvature);
+    m_state.step = m_bracketing.prev_step();
+    m_state.der = m_bracketing.prev_der();
 }
 
-void Searcher::log_x(unsigned iter_num, const std::vector<double> & x)
+template <class Trace>
+double Searcher<Trace>::value_along(const PointT & curr, const std::vector<double> & shift, double alpha)
 {
-    m_replay_data.emplace_back<util::VdComment>(iter_num, "x:");
-    m_replay_data.emplace_back<util::VdPoint>(iter_num, x);
+    util::PhaseTimer timer(util::Phase::Func);
+    return last_func()(util::add(curr, util::mul(shift, alpha)));
 }
 
-void Searcher::log_alpha(unsigned iter_num, double alpha)
+template <class Trace>
+void Searcher<Trace>::values_along(const PointT & curr, const std::vector<double> & shift, const double * alphas, std::size_t count, double * out)
 {
-    m_replay_data.emplace_back<util::VdComment>(iter_num, "alpha:");
-    m_replay_data.emplace_back<util::VdValue>(iter_num, alpha);
+    util::PhaseTimer timer(util::Phase::Func);
+    m_batch_points.resize(curr.size() * count);
+    for (std::size_t i = 0; i < curr.size(); ++i) {
+        double * row = m_batch_points.data() + i * count;
+        for (std::size_t k = 0; k < count; ++k) {
+            row[k] = curr[i] + alphas[k] * shift[i];
+        }
+    }
+    last_func().eval_batch(m_batch_points.data(), count, out);
 }
+
+template <class Trace>
+double Searcher<Trace>::find_alpha(const PointT & curr, const std::vector<double> & shift, double max_eps)
+{
+    util::PhaseTimer timer(util::Phase::LineSearch);
+    auto calculate = [&](double x) { return value_along(curr, shift, x); };
+    auto calculate_batch = [&](const double * alphas, std::size_t count, double * out) {
+        values_along(curr, shift, alphas, count, out);
+    };
+
+    // Value and directional derivative at current point give initial step and line search tolerance
+    auto dual = [&] {
+        util::PhaseTimer timer(util::Phase::Func);
+        return last_func().eval_dual(curr, shift);
+    }();
+    double step = m_bracketing.initial_step(dual.der, 1.);
+    auto bracket = m_bracketing.bracket(calculate, dual.value, dual.der, step);
+    double eps = min1d::line_search_eps(dual.der, m_eps, max_eps);
+
+    double alpha;
+    if (!m_batched_line_search) {
+        m_sd_searcher.change_parameters(eps);
+        alpha = m_sd_searcher.find_min(min1d::Function(calculate, bracket.bounds), bracket);
+    } else {
+        m_batched_searcher.change_parameters(eps);
+        alpha = m_batched_searcher.find_min(min1d::Function(calculate, calculate_batch, bracket.bounds));
+    }
+    m_bracketing.accept(alpha, dual.der);
+    return alpha;
+}
+
+template <class Trace>
+double Searcher<Trace>::find_exact_alpha(const PointT & curr, const std::vector<double> & shift)
+{
+    util::PhaseTimer timer(util::Phase::LineSearch);
+    auto calculate = [&](double x) { return value_along(curr, shift, x); };
+    auto calculate_batch = [&](const double * alphas, std::size_t count, double * out) {
+        values_along(curr, shift, alphas, count, out);
+    };
+
+    const min1d::Function::Bounds bounds{0., ExactSegment};
+    if (!m_batched_line_search) {
+        m_sd_searcher.change_parameters(m_eps);
+        return m_sd_searcher.find_min(min1d::Function(calculate, bounds));
+    }
+    m_batched_searcher.change_parameters(m_eps);
+    return m_batched_searcher.find_min(min1d::Function(calculate, calculate_batch, bounds));
+}
+
+template struct Searcher<util::FullTrace>;
+template struct Searcher<util::NoTrace>;
+template struct Searcher<util::SampledTrace>;
@@ -0,0 +1,181 @@
+#include "nd_methods/ConjugateGradient.h"
+
+#include "util/Arena.h"
+#include "util/Function.h"
+#include "util/Instrument.h"
+#include "util/VectorOps.h"
+#include "util/VersionedData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace min_nd {
+
+namespace {
+
+// Lower bound of Hager-Zhang beta uses this instead of gradient's length far from minimum
+constexpr double HagerZhangEta = 0.01;
+// Powell's restart: successive gradients aren't orthogonal enough, if their product exceeds this part of |g'|^2
+constexpr double OrthogonalityRatio = 0.2;
+
+void eval_grad(const Func<1> & grad, const util::VectorT & x, util::VectorT & out)
+{
+    util::PhaseTimer timer(util::Phase::Grad);
+    grad.eval_into(x, out);
+}
+
+} // anonymous namespace
+
+double ConjugateGradient::count_beta(const util::VectorT & next_grad) const noexcept
+{
+    // All products are counted in one pass, without storing y = g' - g
+    double gg = 0, ngng = 0, yng = 0, yy = 0, dy = 0, dng = 0, dd = 0;
+    for (std::size_t i = 0; i < next_grad.size(); ++i) {
+        double y = next_grad[i] - m_grad[i];
+        gg += m_grad[i] * m_grad[i];
+        ngng += next_grad[i] * next_grad[i];
+        yng += y * next_grad[i];
+        yy += y * y;
+        dy += m_dir[i] * y;
+        dng += m_dir[i] * next_grad[i];
+        dd += m_dir[i] * m_dir[i];
+    }
+
+    switch (m_rule) {
+    case Rule::FletcherReeves:
+        return gg > 0 ? ngng / gg : 0.;
+    case Rule::PolakRibierePlus:
+        return gg > 0 ? std::max(0., yng / gg) : 0.;
+    case Rule::HagerZhang: {
+        if (dy == 0.) {
+            return 0.;
+        }
+        double beta = (yng - 2 * yy * dng / dy) / dy;
+        double eta = -1 / (std::sqrt(dd) * std::min(HagerZhangEta, std::sqrt(gg)));
+        return std::max(beta, eta);
+    }
+    }
+    return 0.;
+}
+
+/*
+ * Idea: the next direction is antigradient plus the previous direction times beta,
+ * so on quadratic function directions are conjugate and minimum is reached in n steps.
+ * Line search along direction is the same as in fastest descent.
+ */
+template <class Trace>
+util::VectorT ConjugateGradient::search(util::VectorT init, Trace trace)
+{
+    auto & func = last_func();
+    const unsigned restart = m_restart != 0 ? m_restart : func.dims();
+
+    util::Arena arena;
+    auto grad = [&] { Fn::ArenaScope scope(arena); return func.grad(); }();
+    m_stats.start();
+    m_termination.start(m_criteria);
+    m_bracketing.reset();
+    if (auto warm = warm_state(func.dims())) {
+        m_bracketing.accept(warm->step, warm->der);
+    }
+    m_restarts = 0;
+
+    m_curr = std::move(init);
+    m_point.resize(m_curr.size());
+    eval_grad(grad, m_curr, m_grad);
+    m_next_grad.resize(m_grad.size());
+    m_dir.resize(m_grad.size());
+    std::transform(m_grad.begin(), m_grad.end(), m_dir.begin(), [](double g) { return -g; });
+
+    // Only "this" is captured, so std::function doesn't allocate
+    auto calculate = [this](double x) {
+        util::PhaseTimer timer(util::Phase::Func);
+        for (std::size_t i = 0; i < m_point.size(); ++i) {
+            m_point[i] = m_curr[i] + x * m_dir[i];
+        }
+        return last_func()(m_point);
+    };
+    double value = [&] {
+        util::PhaseTimer timer(util::Phase::Func);
+        return func(m_curr);
+    }();
+
+    uint iter_num = 0;      // To prevent infinite or very long cycles
+    unsigned since_restart = 0;
+    double step = std::numeric_limits<double>::infinity();
+    while (!m_termination.stop_on_progress(step, std::sqrt(util::length(m_grad))) &&
+            !m_termination.stop_on_limits(iter_num)) {
+        if constexpr (Trace::Enabled) {
+            if (trace.should_log(iter_num)) {
+                m_replay_data.add_point(iter_num, m_curr);
+            }
+        }
+
+        double der = util::scalar(m_grad, m_dir);
+        if (!(der < 0.)) {
+            // Not a descent direction, restart with antigradient
+            std::transform(m_grad.begin(), m_grad.end(), m_dir.begin(), [](double g) { return -g; });
+            der = -util::length(m_grad);
+            since_restart = 0;
+            ++m_restarts;
+        }
+
+        double alpha;
+        {
+            util::PhaseTimer timer(util::Phase::LineSearch);
+            auto bracket = m_bracketing.bracket(calculate, value, der, m_bracketing.initial_step(der, m_init_step));
+            m_sd_searcher.change_parameters(min1d::line_search_eps(der, m_eps));
+            alpha = m_sd_searcher.find_min({calculate, bracket.bounds}, bracket);
+            value = m_sd_searcher.min_value();
+            m_bracketing.accept(alpha, der);
+        }
+        util::add_scaled(m_curr, m_dir, alpha);
+        step = std::abs(alpha) * std::sqrt(util::length(m_dir));
+        eval_grad(grad, m_curr, m_next_grad);
+
+        // Count the next direction
+        {
+            util::PhaseTimer timer(util::Phase::Update);
+            double beta = 0.;
+            if (++since_restart >= restart ||
+                    (m_rule != Rule::HagerZhang &&
+                     std::abs(util::scalar(m_next_grad, m_grad)) >= OrthogonalityRatio * util::length(m_next_grad))) {
+                since_restart = 0;
+                ++m_restarts;
+            } else {
+                beta = count_beta(m_next_grad);
+            }
+            for (std::size_t i = 0; i < m_dir.size(); ++i) {
+                m_dir[i] = beta * m_dir[i] - m_next_grad[i];
+            }
+            std::swap(m_grad, m_next_grad);
+        }
+        m_stats.next_iteration();
+
+        iter_num++;
+    }
+
+    m_stats.finish();
+    m_state = {m_curr, {}, m_bracketing.prev_step(), m_bracketing.prev_der()};
+    return std::move(m_curr);
+}
+
+util::VectorT ConjugateGradient::find_min_impl(util::VectorT init, bool traced)
+{
+    return traced ? search(std::move(init), m_trace) : search(std::move(init), util::NoTrace{});
+}
+
+std::string_view ConjugateGradient::method_name() const noexcept
+{
+    switch (m_rule) {
+    case Rule::FletcherReeves:
+        return "Conjugate gradient (Fletcher-Reeves)";
+    case Rule::PolakRibierePlus:
+        return "Conjugate gradient (Polak-Ribiere+)";
+    case Rule::HagerZhang:
+        return "Conjugate gradient (Hager-Zhang)";
+    }
+    return "Conjugate gradient";
+}
+
+} // namespace min_nd
@@ -3,67 +3,95 @@
 #include "nd_methods/MinSearcher.h"
 #include "sd_methods/MinSearcher.h"
 
+#include "util/Arena.h"
 #include "util/Function.h"
+#include "util/Instrument.h"
 #include "util/VectorOps.h"
 #include "util/VersionedData.h"
 
+#include <cmath>
+#include <limits>
+
 namespace min_nd {
+
+namespace {
+
+util::VectorT eval_grad(const Func<1> & grad, const util::VectorT & x)
+{
+    util::PhaseTimer timer(util::Phase::Grad);
+    return grad(x);
+}
+
+} // anonymous namespace
+
 /*
  * Idea: after finding gradient of the function do not make a small step in the direction of the antigradient.
  * Instead, move, until the function decreases. 
  * After finding minimum on the chosen direction, find function's gradient again. 
  * Repeat the algorithm.
  */
-util::VectorT FastestDescent::find_min_impl()
+template <class Trace>
+util::VectorT FastestDescent::search(util::VectorT init, Trace trace)
 {
-    const double eps_pow2 = m_eps * m_eps;
     auto & func = last_func();
 
-    util::VectorT curr(func.dims()); // Vector of current coordinates
-    double f_curr = func(curr);
+    util::VectorT curr(std::move(init)); // Vector of current coordinates
 
-    auto grad = func.grad();
-    util::VectorT shift = grad(curr);
-    double sd_min;    // Minimum found on the chosen direction
-    uint iter_num = 0;      // To prevent infinite or very long cycles
-    while (util::length(shift) >= eps_pow2 && iter_num < MAX_ITER) {
-        sd_min = find_sd_min({[&](double x) { return func(util::sub(curr, util::mul(shift, x))); }, {0., m_alpha}});
-        curr = util::sub(std::move(curr), util::mul(std::move(shift), sd_min));
-        shift = grad(curr);
-        iter_num++;
+    util::Arena arena;
+    auto grad = [&] { Fn::ArenaScope scope(arena); return func.grad(); }();
+    m_stats.start();
+    m_termination.start(m_criteria);
+    m_bracketing.reset();
+    if (auto warm = warm_state(func.dims())) {
+        m_bracketing.accept(warm->step, warm->der);
     }
+    util::VectorT shift = eval_grad(grad, curr);
+    double sd_min;          // Minimum found on the chosen direction
+    double step_len = std::numeric_limits<double>::infinity();
 
-    return curr;
-}
-
-/*
- * Version with tracing output.
- */
-util::VectorT FastestDescent::find_min_traced_impl(util::VectorT init)
-{
-    const double eps_pow2 = m_eps * m_eps;
-    auto & func = last_func();
-
-    util::VectorT curr(std::move(init));
-    double f_curr = func(curr);
-
-    auto grad = func.grad();
-    util::VectorT shift = grad(curr);
-    double sd_min;
+    uint iter_num = 0;      // To prevent infinite or very long cycles
+    while (!m_termination.stop_on_progress(step_len, std::sqrt(util::length(shift))) &&
+            !m_termination.stop_on_limits(iter_num)) {
+        if constexpr (Trace::Enabled) {
+            if (trace.should_log(iter_num)) {
+                m_replay_data.add_point(iter_num, curr);
+            }
+        }
 
-    uint iter_num = 0;
-    while (util::length(shift) >= eps_pow2 && iter_num < MAX_ITER) {;
-        m_replay_data.emplace_back<util::VdPoint>(iter_num, curr);
+        auto calculate = [&](double x) {
+            util::PhaseTimer timer(util::Phase::Func);
+            return func(util::sub(curr, util::mul(shift, x)));
+        };
+        // Derivative along antigradient is minus squared gradient's length
+        double der = -util::scalar(shift, shift);
+        double step = m_bracketing.initial_step(der, m_init_step);
+        auto bracket = m_bracketing.bracket(calculate, calculate(0.), der, step);
 
-        sd_min = find_sd_min({[&](double x) { return func(util::sub(curr, util::mul(shift, x))); }, {0., m_alpha}});
+        m_sd_searcher.change_parameters(min1d::line_search_eps(der, m_eps));
+        sd_min = find_sd_min({calculate, bracket.bounds}, bracket);
+        m_bracketing.accept(sd_min, der);
+        step_len = std::abs(sd_min) * std::sqrt(-der);
 
         curr = util::sub(std::move(curr), util::mul(std::move(shift), sd_min));
-        shift = grad(curr);
+        shift = eval_grad(grad, curr);
+        m_stats.next_iteration();
 
         iter_num++;
     }
 
+    m_stats.finish();
+    m_state = {curr, {}, m_bracketing.prev_step(), m_bracketing.prev_der()};
     return curr;
 }
 
+util::VectorT FastestDescent::find_min_impl(util::VectorT init, bool traced)
+{
+    return traced ? search(std::move(init), m_trace) : search(std::move(init), util::NoTrace{});
+}
+
+std::string_view FastestDescent::method_name() const noexcept
+{
+    return "Fastest descent";
+}
+
 } // namespace min_nd
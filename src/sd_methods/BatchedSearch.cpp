@@ -0,0 +1,96 @@
+#include "sd_methods/BatchedSearch.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace min1d {
+
+namespace {
+
+// Minimum of parabola through three points, NaN if they lie on a line
+double parabola_min(double a, double f_a, double b, double f_b, double c, double f_c)
+{
+    double num = (b - a) * (b - a) * (f_b - f_c) - (b - c) * (b - c) * (f_b - f_a);
+    double den = (b - a) * (f_b - f_c) - (b - c) * (f_b - f_a);
+    return den != 0. ? b - num / (2 * den) : std::numeric_limits<double>::quiet_NaN();
+}
+
+} // anonymous namespace
+
+double BatchedSearch::find_min_impl() noexcept /*override*/
+{
+    const auto & fn = last_func();
+    auto bnds = fn.bounds();
+    const unsigned ROUNDS_MAX = 100;
+    const double inf = std::numeric_limits<double>::infinity();
+
+    /*
+     * Points of a round: probes, parabola's minimum and the best point of the previous round,
+     * sorted together with segment's ends, which values are unknown (infinity).
+     */
+    double xs[MaxProbes + 4], fs[MaxProbes + 4];
+    double probes[MaxProbes + 1], values[MaxProbes + 1];
+
+    double x = bnds.middle(), f_x = inf;
+    double parabola = std::numeric_limits<double>::quiet_NaN();
+
+    for (m_rounds = 0; m_rounds < ROUNDS_MAX; ++m_rounds) {
+        double to_leave = m_eps * std::abs(x) + m_eps / 10;
+        if (bnds.length() <= 4 * to_leave) {
+            break;
+        }
+
+        // All probes of the round are evaluated in one call
+        unsigned cnt = 0;
+        double step = bnds.length() / (m_probes + 1);
+        for (unsigned i = 1; i <= m_probes; ++i) {
+            probes[cnt++] = bnds.from + i * step;
+        }
+        if (bnds.from < parabola && parabola < bnds.to) {
+            probes[cnt++] = parabola;
+        }
+        fn(probes, cnt, values);
+
+        unsigned n = 0;
+        xs[n] = bnds.from;
+        fs[n++] = inf;
+        for (unsigned i = 0; i < cnt; ++i) {
+            xs[n] = probes[i];
+            fs[n++] = values[i];
+        }
+        if (f_x != inf) {
+            xs[n] = x;
+            fs[n++] = f_x;
+        }
+        xs[n] = bnds.to;
+        fs[n++] = inf;
+
+        // Probes are already sorted, only two points are out of order, so insertion sort is cheap
+        for (unsigned i = 1; i < n; ++i) {
+            for (unsigned j = i; j > 0 && xs[j - 1] > xs[j]; --j) {
+                std::swap(xs[j - 1], xs[j]);
+                std::swap(fs[j - 1], fs[j]);
+            }
+        }
+
+        unsigned best = 1;
+        for (unsigned i = 2; i + 1 < n; ++i) {
+            best = fs[i] < fs[best] ? i : best;
+        }
+
+        // Unimodal function's minimum lies between neighbours of the best point
+        x = xs[best];
+        f_x = fs[best];
+        bnds.from = xs[best - 1];
+        bnds.to = xs[best + 1];
+
+        parabola = (fs[best - 1] != inf && fs[best + 1] != inf)
+            ? parabola_min(xs[best - 1], fs[best - 1], x, f_x, xs[best + 1], fs[best + 1])
+            : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    return x;
+}
+
+} // namespace min1d
@@ -0,0 +1,62 @@
+#include "sd_methods/Bracketing.h"
+
+#include <cmath>
+#include <limits>
+
+namespace min1d {
+
+double Bracketing::initial_step(double der, double default_step) const noexcept
+{
+    if (m_prev_step <= 0. || der >= 0. || m_prev_der >= 0.) {
+        return default_step;
+    }
+    double res = m_prev_step * m_prev_der / der;
+    return std::isfinite(res) ? std::clamp(res, MinStep, MaxStep) : default_step;
+}
+
+auto Bracketing::bracket(const util::CalculateFunc & func, double value, double der, double step) const -> Bracket
+{
+    const double unknown = std::numeric_limits<double>::infinity();
+    if (!(der < 0.)) {
+        return {{0., AscentSegment * step}, 0., unknown, value, unknown};
+    }
+
+    double f_step = func(step);
+    if (!(f_step < value)) {
+        /*
+         * Function doesn't decrease at the step, minimum is closer to 0.
+         * Contract until it decreases, minimum lies before the previous step.
+         */
+        double prev = step, f_prev = f_step;
+        while (step > MinStep) {
+            prev = step;
+            f_prev = f_step;
+            step *= Shrink;
+            f_step = func(step);
+            if (f_step < value) {
+                return {{0., prev}, step, f_step, value, f_prev};
+            }
+        }
+        return {{0., prev}, 0., value, value, f_prev};
+    }
+
+    /*
+     * Function decreases, expand until it grows,
+     * minimum lies between the last three steps.
+     */
+    double from = 0., f_from = value;
+    while (step < MaxStep) {
+        double next = step * Grow;
+        double f_next = func(next);
+        if (!(f_next < f_step)) {
+            return {{from, next}, step, f_step, f_from, f_next};
+        }
+        from = step;
+        f_from = f_step;
+        step = next;
+        f_step = f_next;
+    }
+    return {{from, step}, step, f_step, f_from, unknown};
+}
+
+} // namespace min1d
@@ -50,8 +50,23 @@ double Brent::find_min_impl() noexcept /*override*/
      */
     double x, w, v;
     double f_x, f_w, f_v;
-    x = w = v = bnds.from + TAU * bnds.length();
-    f_x = f_w = f_v = fn(x);
+    if (m_start && std::isfinite(m_start->f_x)) {
+        /*
+         * Start from the lowest point of bracket, its ends are the other two points, if their values are known.
+         */
+        x = w = v = m_start->x;
+        f_x = f_w = f_v = m_start->f_x;
+        if (std::isfinite(m_start->f_from) && std::isfinite(m_start->f_to)) {
+            w = bnds.from;
+            f_w = m_start->f_from;
+            v = bnds.to;
+            f_v = m_start->f_to;
+        }
+    } else {
+        x = w = v = bnds.from + TAU * bnds.length();
+        f_x = f_w = f_v = fn(x);
+    }
+    m_start.reset();
 
     double step, prev_step;
     step = prev_step = bnds.length();
@@ -151,6 +166,7 @@ double Brent::find_min_impl() noexcept /*override*/
         }
     }
 
+    m_min_value = f_x;
     return x;
 }
 
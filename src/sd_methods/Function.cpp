@@ -10,6 +10,25 @@ Function::Function(util::CalculateFunc calculate, Bounds bounds, std::string as_
     , m_bounds(bounds)
 {}
 
+Function::Function(util::CalculateFunc calculate, util::CalculateBatchFunc calculate_batch, Bounds bounds, std::string as_string)
+    : m_as_string(std::move(as_string))
+    , m_calculate(std::move(calculate))
+    , m_calculate_batch(std::move(calculate_batch))
+    , m_bounds(bounds)
+{}
+
+void Function::operator()(const double * xs, std::size_t count, double * out) const
+{
+    m_call_count += count;
+    if (m_calculate_batch) {
+        m_calculate_batch(xs, count, out);
+        return;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        out[i] = m_calculate(xs[i]);
+    }
+}
+
 void Function::reset(std::string as_string, util::CalculateFunc calculate)
 {
     m_as_string = std::move(as_string);
@@ -0,0 +1,144 @@
+#include "sole-solver/Kernels.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+using value_t = Kernels::value_t;
+using id_t = Kernels::id_t;
+
+unsigned thread_count(unsigned threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return std::max(threads, 1u);
+}
+
+// Calls func(k) for every k in [0, count), values of k are distributed between threads in turn
+template <class Func>
+void run_parallel(id_t count, unsigned threads, Func && func)
+{
+    threads = static_cast<unsigned>(std::min<id_t>(threads, count));
+    auto work = [&func, count, threads](unsigned first) {
+        for (id_t k = first; k < count; k += threads) {
+            func(k);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (auto & worker : workers) {
+        worker.join();
+    }
+}
+
+/*
+ * Adds products of diagonal and lower part of rows [first, last) to "out",
+ * products of upper part (stored by columns) are added to scatter[col - offset]
+ */
+template <class M>
+void multiply_rows(const M & m, const value_t * vec, id_t first, id_t last, value_t * out, value_t * scatter, id_t offset)
+{
+    const value_t * diag = m.diagonal();
+    const value_t * low = m.lower();
+    const value_t * up = m.upper();
+    for (id_t row = first; row < last; ++row) {
+        const value_t x = vec[row];
+        value_t sum = diag[row] * x;
+        for (id_t pos = m.row_begin(row), end = m.row_end(row); pos < end; ++pos) {
+            id_t col = m.col_of(row, pos);
+            sum += low[pos] * vec[col];
+            scatter[col - offset] += up[pos] * x;
+        }
+        out[row] += sum;
+    }
+}
+
+/*
+ * Every chunk of rows gathers its lower part directly to "out", as no other chunk writes these rows,
+ * and scatters its upper part to its own buffer from the first column it touches.
+ * Then every chunk of "out" adds buffers, which overlap it, in the order of chunks.
+ */
+template <class M>
+void multiply_chunks(const M & m, const value_t * vec, value_t * out, unsigned threads)
+{
+    const id_t dims = m.row_cnt();
+    const id_t chunks = (dims + Kernels::ChunkRows - 1) / Kernels::ChunkRows;
+    auto chunk_end = [dims](id_t k) { return std::min(dims, (k + 1) * Kernels::ChunkRows); };
+
+    std::vector<id_t> lowest(chunks);                               // first column scattered by chunk
+    std::vector<std::vector<value_t>> scattered(chunks);
+    run_parallel(chunks, threads, [&](id_t k) {
+        const id_t first = k * Kernels::ChunkRows, last = chunk_end(k);
+        id_t lo = first;
+        for (id_t row = first; row < last; ++row) {
+            if (m.row_begin(row) < m.row_end(row)) {
+                lo = std::min(lo, m.col_of(row, m.row_begin(row)));
+            }
+        }
+        lowest[k] = lo;
+        scattered[k].assign(last - lo, 0.);
+        multiply_rows(m, vec, first, last, out, scattered[k].data(), lo);
+    });
+
+    run_parallel(chunks, threads, [&](id_t k) {
+        const id_t first = k * Kernels::ChunkRows, last = chunk_end(k);
+        for (id_t src = k; src < chunks; ++src) {
+            const id_t lo = lowest[src];
+            const value_t * values = scattered[src].data();
+            for (id_t col = std::max(first, lo), end = std::min(last, chunk_end(src)); col < end; ++col) {
+                out[col] += values[col - lo];
+            }
+        }
+    });
+}
+
+template <class M>
+void multiply(const M & m, const std::vector<value_t> & vec, std::vector<value_t> & out, unsigned threads)
+{
+    const id_t dims = m.row_cnt();
+    out.assign(dims, 0.);
+    if (dims <= Kernels::ChunkRows) {
+        multiply_rows(m, vec.data(), 0, dims, out.data(), out.data(), 0);
+    } else {
+        multiply_chunks(m, vec.data(), out.data(), thread_count(threads));
+    }
+}
+
+} // anonymous namespace
+
+/*static*/ void Kernels::multiply(const ProfileMatrix & m, const std::vector<value_t> & vec, std::vector<value_t> & out, unsigned threads)
+{
+    ::multiply(m, vec, out, threads);
+}
+
+/*static*/ void Kernels::multiply(const SparseMatrix & m, const std::vector<value_t> & vec, std::vector<value_t> & out, unsigned threads)
+{
+    ::multiply(m, vec, out, threads);
+}
+
+/*static*/ auto Kernels::forward_substitution(const ProfileMatrix & lu, std::vector<value_t> & b) -> id_t
+{
+    return forward_substitution(lu, lu.lower(), b);
+}
+
+/*static*/ auto Kernels::forward_substitution(const SparseMatrix & lu, std::vector<value_t> & b) -> id_t
+{
+    return forward_substitution(lu, lu.lower(), b);
+}
+
+/*static*/ auto Kernels::backward_substitution(const ProfileMatrix & lu, std::vector<value_t> & b) -> id_t
+{
+    return backward_substitution(lu, lu.diagonal(), lu.upper(), b);
+}
+
+/*static*/ auto Kernels::backward_substitution(const SparseMatrix & lu, std::vector<value_t> & b) -> id_t
+{
+    return backward_substitution(lu, lu.diagonal(), lu.upper(), b);
+}
@@ -6,12 +6,17 @@ auto Matrix::operator*(const std::vector<value_t>& vec) const -> std::vector<val
 {
     assert(col_cnt() == vec.size() && "Dimension mismatch in matrix * vector");
     std::vector<value_t> answer(row_cnt(), 0.);
-    for (id_t row = 0; row < answer.size(); row++)
+    multiply_into(vec, answer);
+    return answer;
+}
+
+void Matrix::multiply_into(const std::vector<value_t>& vec, std::vector<value_t>& out) const
+{
+    for (id_t row = 0; row < out.size(); row++)
     {
         for (id_t column = 0; column < vec.size(); column++)
         {
-            answer[row] += get(row, column) * vec[column];
+            out[row] += get(row, column) * vec[column];
         }
     }
-    return answer;
 }
\ No newline at end of file
@@ -1,9 +1,9 @@
 #include "sole-solver/ProfileMatrix.h"
+#include "sole-solver/Kernels.h"
 #include "sole-solver/Matrix.h"
 
 #include <algorithm>
 #include <cassert>
-#include <cmath>
 #include <iomanip>
 
 ProfileMatrix::ProfileMatrix(const Matrix & matrix)
@@ -72,49 +72,15 @@ ProfileMatrix::ProfileMatrix(
     return ProfileMatrix(matrix);
 }
 
-auto ProfileMatrix::get(id_t row, id_t col) const -> value_t /*override*/
+void ProfileMatrix::multiply_into(const value_vec& vec, value_vec& out) const /*override*/
 {
-    auto res = get_ptr(row, col);
-    return res ? *res : 0;
+    Kernels::multiply(*this, vec, out);
 }
 
-void ProfileMatrix::set(id_t row, id_t col, value_t val) /*override*/
+std::size_t ProfileMatrix::footprint() const
 {
-    auto changed = get_ptr(row, col);
-    if (changed) {
-        *changed = val;
-    }
-}
-
-auto ProfileMatrix::get_ptr(id_t row, id_t col) const -> const value_t *
-{
-    assert(row >= 0 && col >= 0
-        && row < diag.size() && col < diag.size()
-        && "Row and column indexes must be in bounds to get");
-
-    if (row == col)
-    {
-        return &diag[row];
-    }
-
-    bool is_lower = col < row;
-    if (!is_lower)
-    {
-        std::swap(col, row);
-    }
-
-    id_t prof_val = prof[row + 1] - prof[row];
-    if (prof_val < row - col)
-    {
-        return nullptr;
-    }
-    id_t pos = (prof[row] - 1) + prof_val - (row - col);
-    return is_lower ? &a_low[pos] : &a_up[pos];
-}
-
-auto ProfileMatrix::get_ptr(id_t row, id_t col) -> value_t*
-{
-    return const_cast<value_t*>(const_cast<const ProfileMatrix*>(this)->get_ptr(row, col));
+    return (diag.capacity() + a_low.capacity() + a_up.capacity()) * sizeof(value_t)
+        + prof.capacity() * sizeof(id_t);
 }
 
 template<class T>
@@ -1,6 +1,5 @@
 #include "sole-solver/QuadMatrix.h"
 
-#include <cassert>
 #include <iomanip>
 
 QuadMatrix::QuadMatrix(std::vector<value_vec> other_matrix)
@@ -16,18 +15,18 @@ auto QuadMatrix::get_matrix() const -> const std::vector<value_vec> &
     return matrix;
 }
 
-auto QuadMatrix::get(id_t row, id_t col) const -> value_t /*override*/
+void QuadMatrix::multiply_into(const value_vec& vec, value_vec& out) const /*override*/
 {
-    assert(row >= 0 && col >= 0 && row < matrix.size() && (!matrix.size() || col < matrix.front().size())
-        && "Indexes out of bounds in QuadMatrix get");
-    return matrix[row][col];
-}
-
-void QuadMatrix::set(id_t row, id_t col, value_t val) /*override*/
-{
-    assert(row >= 0 && col >= 0 && row < matrix.size() && (!matrix.size() || col < matrix.front().size())
-        && "Indexes out of bounds in QuadMatrix set");
-    matrix[row][col] = val;
+    for (id_t row = 0; row < out.size(); row++)
+    {
+        const value_vec & values = matrix[row];
+        value_t sum = 0;
+        for (id_t column = 0; column < vec.size(); column++)
+        {
+            sum += values[column] * vec[column];
+        }
+        out[row] += sum;
+    }
 }
 
 std::ostream& operator<<(std::ostream& os, const QuadMatrix& qm)
@@ -43,4 +42,13 @@ std::ostream& operator<<(std::ostream& os, const QuadMatrix& qm)
         os << '\n';
     }
     return os;
-}
\ No newline at end of file
+}
+std::size_t QuadMatrix::footprint() const
+{
+    std::size_t res = matrix.capacity() * sizeof(value_vec);
+    for (const auto & row : matrix)
+    {
+        res += row.capacity() * sizeof(value_t);
+    }
+    return res;
+}
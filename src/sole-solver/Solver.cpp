@@ -1,11 +1,48 @@
 #include "sole-solver/Solver.h"
+#include "sole-solver/Kernels.h"
 #include "sole-solver/LUMatrixViews.h"
 #include "sole-solver/ProfileMatrix.h"
+#include "sole-solver/QuadMatrix.h"
+#include "sole-solver/SparseMatrix.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <limits>
 #include <numeric>
+#include <optional>
 
-/*static*/ auto Solver::solve_gauss(Matrix&& a, std::vector<value_t>&& b) -> Result
+namespace {
+
+using value_t = Solver::value_t;
+using id_t = Solver::id_t;
+using Result = Solver::Result;
+
+/*
+ * Calls "func" with "a" cast to its storage type, so algorithms are instantiated for every storage
+ * and don't access elements through virtual calls. Unknown matrices are passed as Matrix.
+ */
+template <class Func>
+decltype(auto) visit_storage(Matrix & a, Func && func)
+{
+    if (auto quad = dynamic_cast<QuadMatrix *>(&a)) {
+        return func(*quad);
+    }
+    if (auto profile = dynamic_cast<ProfileMatrix *>(&a)) {
+        return func(*profile);
+    }
+    if (auto sparse = dynamic_cast<SparseMatrix *>(&a)) {
+        return func(*sparse);
+    }
+    return func(a);
+}
+
+/*
+ * Gauss with pivot element choice.
+ * Instantiated for every storage, so get and set are not virtual calls for them.
+ */
+template <class M>
+Result gauss(M & a, std::vector<value_t> & b)
 {
     id_t actions_cnt = 0;                                           // counter for mult and div operations
     /*
@@ -99,7 +136,10 @@
     return { answer, actions_cnt };
 }
 
-/*static*/ auto Solver::solve_lu(Matrix && a, std::vector<value_t> && b) -> Result
+/*
+ * LU-decomposition of any matrix through the Matrix interface, used for storages unknown to solver
+ */
+Result generic_lu(Matrix && a, std::vector<value_t> & b)
 {
     bool untrusted_flag = false;                                    // flag for division by near-epsilon number
     id_t actions_cnt = 0;                                           // counter for mult and div operations
@@ -145,5 +185,486 @@
         actions_cnt++;
     }
 
-    return { b, actions_cnt };
+    return { std::move(b), actions_cnt };
+}
+
+/*
+ * Calls func(q, r) for every column k stored both in row "row_a" before position "end_a"
+ * and in row "row_b", q and r are positions of k in these rows (column "row_b" is at "end_a" in decomposition).
+ * Columns of rows are sorted, so patterns are merged; profile rows are contiguous, so their overlap is direct.
+ */
+template <class M, class Func>
+void for_common(const M & a, id_t row_a, id_t end_a, id_t row_b, Func && func)
+{
+    id_t q = a.row_begin(row_a), r = a.row_begin(row_b);
+    id_t end_b = a.row_end(row_b);
+    while (q < end_a && r < end_b) {
+        id_t k_a = a.col_of(row_a, q), k_b = a.col_of(row_b, r);
+        if (k_a == k_b) {
+            func(q++, r++);
+        } else if (k_a < k_b) {
+            ++q;
+        } else {
+            ++r;
+        }
+    }
+}
+
+template <class Func>
+void for_common(const ProfileMatrix & a, id_t row_a, id_t end_a, id_t row_b, Func && func)
+{
+    id_t first_a = a.col_of(row_a, a.row_begin(row_a)), first_b = a.col_of(row_b, a.row_begin(row_b));
+    id_t first = std::max(first_a, first_b);
+    id_t q = a.row_begin(row_a) + (first - first_a), r = a.row_begin(row_b) + (first - first_b);
+    for (; q < end_a; ++q, ++r) {
+        func(q, r);
+    }
+}
+
+/*
+ * LU-decomposition in place over stored elements of ProfileMatrix or SparseMatrix:
+ * L (with unit diagonal) in the lower part, U in the diagonal and upper part.
+ * Elements are counted by the same formulas and in the same order of terms as generic_lu does,
+ * but only the terms with both factors stored are visited.
+ * Fill-in outside of the stored pattern is dropped, as set() of these cells does nothing.
+ * Factors are in arrays of precision T in the pattern of "a".
+ */
+template <class M, class T>
+void decompose(const M & a, T * diag, T * low, T * up)
+{
+    for (id_t i = 0; i < a.row_cnt(); ++i) {
+        const id_t begin = a.row_begin(i), end = a.row_end(i);
+        for (id_t p = begin; p < end; ++p) {
+            id_t j = a.col_of(i, p);
+            T l = low[p];                                           // l[i][j] = (a[i][j] - sum l[i][k] * u[k][j]) / u[j][j]
+            T u = up[p];                                            // u[j][i] = a[j][i] - sum l[j][k] * u[k][i]
+            for_common(a, i, p, j, [&](id_t q, id_t r) {
+                l -= low[q] * up[r];
+                u -= low[r] * up[q];
+            });
+            low[p] = l / diag[j];
+            up[p] = u;
+        }
+        T d = diag[i];
+        for (id_t p = begin; p < end; ++p) {
+            d -= low[p] * up[p];
+        }
+        diag[i] = d;
+    }
+}
+
+// LU-decomposition of dense matrix, directly in its rows
+void decompose_dense(std::vector<std::vector<value_t>> & m)
+{
+    const id_t dims = m.size();
+    for (id_t i = 0; i < dims; ++i) {
+        auto & row = m[i];
+        for (id_t j = 0; j < dims; ++j) {
+            value_t cell = row[j];
+            for (id_t k = 0; k < std::min(i, j); ++k) {
+                cell -= row[k] * m[k][j];
+            }
+            if (i > j) {
+                cell /= m[j][j];
+            }
+            row[j] = cell;
+        }
+    }
+}
+
+// Solve L * U * x = b for decomposed dense matrix, returns number of multiplications and divisions
+id_t substitute_dense(const std::vector<std::vector<value_t>> & m, std::vector<value_t> & b)
+{
+    const id_t dims = b.size();
+    for (id_t i = 0; i < dims; i++)
+    {
+        for (id_t j = 0; j < i; j++)
+        {
+            b[i] -= b[j] * m[i][j];
+        }
+    }
+    for (id_t i = dims; i-- > 0;)
+    {
+        for (id_t j = i + 1; j < dims; j++)
+        {
+            b[i] -= m[i][j] * b[j];
+        }
+        b[i] /= m[i][i];
+    }
+    return dims * dims;
+}
+
+// Block of right parts for decomposed dense matrix, see Kernels::forward_substitution
+id_t substitute_dense(const std::vector<std::vector<value_t>> & m, value_t * block, id_t count)
+{
+    const id_t dims = m.size();
+    for (id_t i = 0; i < dims; i++)
+    {
+        value_t * row = block + i * count;
+        for (id_t j = 0; j < i; j++)
+        {
+            const value_t * known = block + j * count;
+            const value_t l = m[i][j];
+            for (id_t k = 0; k < count; k++)
+            {
+                row[k] -= known[k] * l;
+            }
+        }
+    }
+    for (id_t i = dims; i-- > 0;)
+    {
+        value_t * row = block + i * count;
+        for (id_t j = i + 1; j < dims; j++)
+        {
+            const value_t * known = block + j * count;
+            const value_t u = m[i][j];
+            for (id_t k = 0; k < count; k++)
+            {
+                row[k] -= u * known[k];
+            }
+        }
+        const value_t d = m[i][i];
+        for (id_t k = 0; k < count; k++)
+        {
+            row[k] /= d;
+        }
+    }
+    return dims * dims * count;
+}
+
+// LU-decomposition in place and substitutions of every storage
+template <class M>
+void decompose_storage(M & a)
+{
+    decompose(a, a.diagonal(), a.lower(), a.upper());
+}
+
+void decompose_storage(QuadMatrix & a)
+{
+    decompose_dense(a.get_matrix());
+}
+
+template <class M>
+id_t substitute(const M & lu, std::vector<value_t> & b)
+{
+    id_t actions_cnt = Kernels::forward_substitution(lu, b);
+    return actions_cnt + Kernels::backward_substitution(lu, b);
+}
+
+id_t substitute(const QuadMatrix & lu, std::vector<value_t> & b)
+{
+    return substitute_dense(lu.get_matrix(), b);
+}
+
+template <class M>
+id_t substitute(const M & lu, value_t * block, id_t count)
+{
+    id_t actions_cnt = Kernels::forward_substitution(lu, lu.lower(), block, count);
+    return actions_cnt + Kernels::backward_substitution(lu, lu.diagonal(), lu.upper(), block, count);
+}
+
+id_t substitute(const QuadMatrix & lu, value_t * block, id_t count)
+{
+    return substitute_dense(lu.get_matrix(), block, count);
+}
+
+template <class M>
+Result storage_lu(M & a, std::vector<value_t> & b)
+{
+    decompose_storage(a);
+    id_t actions_cnt = substitute(a, b);
+    return { std::move(b), actions_cnt };
+}
+
+Result storage_lu(Matrix & a, std::vector<value_t> & b)
+{
+    return generic_lu(std::move(a), b);
+}
+
+template <class T>
+bool all_finite(const std::vector<T> & values)
+{
+    return std::all_of(values.begin(), values.end(), [](T val) { return std::isfinite(val); });
+}
+
+/*
+ * LU-factors of ProfileMatrix or SparseMatrix in single precision, in the same pattern as the matrix.
+ * The matrix itself isn't changed, it's used for residuals in double precision.
+ */
+template <class M>
+struct SingleFactors
+{
+    explicit SingleFactors(const M & a)
+        : pattern(a)
+        , diag(a.diagonal(), a.diagonal() + a.row_cnt())
+        , low(a.lower(), a.lower() + stored(a))
+        , up(a.upper(), a.upper() + stored(a))
+    {}
+
+    // Returns false, if factors aren't finite
+    bool decompose()
+    {
+        ::decompose(pattern, diag.data(), low.data(), up.data());
+        return all_finite(diag) && all_finite(low) && all_finite(up);
+    }
+
+    id_t solve(std::vector<value_t> & b) const
+    {
+        id_t actions_cnt = Kernels::forward_substitution(pattern, low.data(), b);
+        return actions_cnt + Kernels::backward_substitution(pattern, diag.data(), up.data(), b);
+    }
+
+    // Multiplications of matrix-vector product
+    id_t product_actions() const { return diag.size() + 2 * low.size(); }
+
+    static id_t stored(const M & a) { return a.row_end(a.row_cnt() - 1); }
+
+    const M & pattern;
+    std::vector<float> diag;
+    std::vector<float> low;
+    std::vector<float> up;
+};
+
+/*
+ * LU-factors of dense matrix in single precision, row-major.
+ * Row is eliminated by the previous rows (i-k-j order), so the inner loop runs over contiguous elements.
+ */
+template <>
+struct SingleFactors<QuadMatrix>
+{
+    explicit SingleFactors(const QuadMatrix & a)
+        : dims(a.row_cnt())
+    {
+        values.reserve(dims * dims);
+        for (const auto & row : a.get_matrix()) {
+            values.insert(values.end(), row.begin(), row.end());
+        }
+    }
+
+    bool decompose()
+    {
+        for (id_t i = 1; i < dims; ++i) {
+            float * row = &values[i * dims];
+            for (id_t k = 0; k < i; ++k) {
+                const float * pivot_row = &values[k * dims];
+                const float l = row[k] /= pivot_row[k];
+                for (id_t j = k + 1; j < dims; ++j) {
+                    row[j] -= l * pivot_row[j];
+                }
+            }
+        }
+        return all_finite(values);
+    }
+
+    id_t solve(std::vector<value_t> & b) const
+    {
+        for (id_t i = 0; i < dims; i++)
+        {
+            const float * row = &values[i * dims];
+            for (id_t j = 0; j < i; j++)
+            {
+                b[i] -= b[j] * row[j];
+            }
+        }
+        for (id_t i = dims; i-- > 0;)
+        {
+            const float * row = &values[i * dims];
+            for (id_t j = i + 1; j < dims; j++)
+            {
+                b[i] -= row[j] * b[j];
+            }
+            b[i] /= row[i];
+        }
+        return dims * dims;
+    }
+
+    id_t product_actions() const { return dims * dims; }
+
+    id_t dims;
+    std::vector<float> values;
+};
+
+// Max-norm of matrix: the largest sum of absolute values in a row
+template <class M>
+value_t max_norm(const M & a)
+{
+    const id_t dims = a.row_cnt();
+    std::vector<value_t> sums(dims);
+    for (id_t i = 0; i < dims; ++i) {
+        value_t sum = std::abs(a.diagonal()[i]);
+        for (id_t p = a.row_begin(i), end = a.row_end(i); p < end; ++p) {
+            sum += std::abs(a.lower()[p]);
+            sums[a.col_of(i, p)] += std::abs(a.upper()[p]);
+        }
+        sums[i] += sum;
+    }
+    return *std::max_element(sums.begin(), sums.end());
+}
+
+value_t max_norm(const QuadMatrix & a)
+{
+    value_t res = 0;
+    for (const auto & row : a.get_matrix()) {
+        value_t sum = 0;
+        for (value_t val : row) {
+            sum += std::abs(val);
+        }
+        res = std::max(res, sum);
+    }
+    return res;
+}
+
+value_t max_norm(const std::vector<value_t> & vec)
+{
+    value_t res = 0;
+    for (value_t val : vec) {
+        res = std::max(res, std::abs(val));
+    }
+    return res;
+}
+
+// Residual of refinement has to decrease at least by this ratio every step, otherwise it's too slow
+constexpr value_t ContractionRatio = 0.5;
+
+// r = b - a * x in double precision
+template <class M>
+std::vector<value_t> residual(const M & a, const std::vector<value_t> & x, const std::vector<value_t> & b)
+{
+    std::vector<value_t> r = a * x;
+    for (id_t i = 0; i < r.size(); ++i) {
+        r[i] = b[i] - r[i];
+    }
+    return r;
+}
+
+/*
+ * Mixed precision LU: matrix is factorized in single precision, then the solution is refined:
+ *  r = b - A * x in double precision, L * U * d = r, x = x + d
+ * Refinement stops, when |r| < |x| * |A| * eps * sqrt(n) (the criterion of LAPACK's dsgesv).
+ * If factors aren't finite, residual decreases less than by ContractionRatio in a step
+ * or MaxRefinements steps aren't enough, the matrix is factorized in double precision.
+ * The refined point with the least residual is returned instead, if its residual is less than
+ * the one of double precision answer (it happens for sparse storage, which drops fill-in).
+ */
+template <class M>
+Result refined_lu(M & a, std::vector<value_t> & b)
+{
+    const id_t dims = b.size();
+    const value_t tolerance = max_norm(a) * std::numeric_limits<value_t>::epsilon() * std::sqrt(static_cast<value_t>(dims));
+
+    id_t actions_cnt = 0;
+    id_t refinements = 0;
+    std::vector<value_t> best;                                      // refined point with the least residual
+    value_t best_norm = std::numeric_limits<value_t>::infinity();
+    SingleFactors<M> factors(a);
+    if (factors.decompose()) {
+        std::vector<value_t> x = b;
+        actions_cnt += factors.solve(x);
+
+        value_t prev_norm = std::numeric_limits<value_t>::infinity();
+        for (;;) {
+            std::vector<value_t> r = residual(a, x, b);
+            actions_cnt += factors.product_actions();
+
+            value_t r_norm = max_norm(r);
+            if (r_norm < max_norm(x) * tolerance) {
+                Result res{ std::move(x), actions_cnt };
+                res.refinements = refinements;
+                return res;
+            }
+            if (r_norm < best_norm) {
+                best = x;
+                best_norm = r_norm;
+            }
+            if (!(r_norm <= ContractionRatio * prev_norm) || refinements == Solver::MaxRefinements) {
+                break;
+            }
+            prev_norm = r_norm;
+
+            actions_cnt += factors.solve(r);
+            for (id_t i = 0; i < dims; ++i) {
+                x[i] += r[i];
+            }
+            ++refinements;
+        }
+    }
+
+    // Matrix is decomposed in place, so it's kept for the residual of the fallback answer
+    std::optional<M> original;
+    std::vector<value_t> right;
+    if (!best.empty()) {
+        original.emplace(a);
+        right = b;
+    }
+
+    Result res = storage_lu(a, b);
+    if (res.actions != Result::FAILED) {
+        res.actions += actions_cnt;
+    }
+    if (original) {
+        res.actions += factors.product_actions();
+        if (!(max_norm(residual(*original, res.answer, right)) <= best_norm)) {
+            res.answer = std::move(best);
+        }
+    }
+    res.refinements = refinements;
+    res.double_fallback = true;
+    return res;
+}
+
+Result refined_lu(Matrix & a, std::vector<value_t> & b)
+{
+    return generic_lu(std::move(a), b);
+}
+
+// Decomposed matrix is moved to factorization, as in solve_lu it's decomposed in place
+template <class M>
+Solver::Factorization::Storage factorize_storage(M & a)
+{
+    decompose_storage(a);
+    return std::move(a);
+}
+
+Solver::Factorization::Storage factorize_storage(Matrix & a)
+{
+    return ProfileMatrix::lu_decompose(std::move(a));
+}
+
+} // anonymous namespace
+
+/*static*/ auto Solver::solve_gauss(Matrix&& a, std::vector<value_t>&& b) -> Result
+{
+    return visit_storage(a, [&b](auto & m) { return gauss(m, b); });
+}
+
+/*static*/ auto Solver::solve_lu(Matrix && a, std::vector<value_t> && b) -> Result
+{
+    return visit_storage(a, [&b](auto & m) { return storage_lu(m, b); });
+}
+
+/*static*/ auto Solver::solve_lu_refined(Matrix && a, std::vector<value_t> && b) -> Result
+{
+    return visit_storage(a, [&b](auto & m) { return refined_lu(m, b); });
+}
+
+/*static*/ auto Solver::factorize_lu(Matrix && a) -> Factorization
+{
+    return Factorization(visit_storage(a, [](auto & m) { return factorize_storage(m); }));
+}
+
+auto Solver::Factorization::dims() const -> id_t
+{
+    return std::visit([](const auto & lu) { return lu.row_cnt(); }, m_lu);
+}
+
+auto Solver::Factorization::solve(std::vector<value_t> b) const -> Result
+{
+    id_t actions_cnt = std::visit([&b](const auto & lu) { return substitute(lu, b); }, m_lu);
+    return { std::move(b), actions_cnt };
+}
+
+auto Solver::Factorization::solve(std::vector<value_t> & rhs, id_t count) const -> id_t
+{
+    assert(rhs.size() == dims() * count && "Block of right parts must contain \"count\" values for every row");
+    return std::visit([&rhs, count](const auto & lu) { return substitute(lu, rhs.data(), count); }, m_lu);
 }
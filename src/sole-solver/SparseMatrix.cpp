@@ -1,4 +1,5 @@
 #include "sole-solver/SparseMatrix.h"
+#include "sole-solver/Kernels.h"
 
 #include <cassert>
 #include <iomanip>
@@ -47,51 +48,15 @@ SparseMatrix::SparseMatrix(
     , i_prof(std::move(i_profile))
 {}
 
-auto SparseMatrix::get(id_t row, id_t col) const -> value_t /*override*/
+void SparseMatrix::multiply_into(const value_vec& vec, value_vec& out) const /*override*/
 {
-    auto res = get_ptr(row, col);
-    return res ? *res : 0;
+    Kernels::multiply(*this, vec, out);
 }
 
-void SparseMatrix::set(id_t row, id_t col, value_t val) /*override*/
+std::size_t SparseMatrix::footprint() const
 {
-    auto changed = get_ptr(row, col);
-    if (changed)
-    {
-        *changed = val;
-    }
-}
-
-auto SparseMatrix::get_ptr(id_t row, id_t col) const -> const value_t*
-{
-    assert(row >= 0 && col >= 0
-           && row < diag.size() && col < diag.size()
-           && "Row and column indexes must be in bounds to get");
-
-    if (row == col)
-    { return &diag[row]; }
-
-    bool is_lower = col < row;
-    if (!is_lower)
-    {
-        std::swap(col, row);
-    }
-
-    id_t prof_val = i_prof[row + 1] - i_prof[row];
-    id_t start_pos = i_prof[row] - 1;
-    for (id_t i = start_pos; i < start_pos + prof_val; i++)
-    {
-        if (j_prof[i] == col)
-        {
-            return is_lower ? &a_low[i] : &a_up[i];
-        }
-    }
-    return nullptr;
-}
-
-auto SparseMatrix::get_ptr(id_t row, id_t col) -> value_t*
-{
-    return const_cast<value_t*>(const_cast<const SparseMatrix*>(this)->get_ptr(row, col));
+    return (diag.capacity() + a_low.capacity() + a_up.capacity()) * sizeof(value_t)
+        + (j_prof.capacity() + i_prof.capacity()) * sizeof(id_t);
 }
 
 template<class T>
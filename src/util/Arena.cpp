@@ -0,0 +1,30 @@
+#include "util/Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace util {
+
+void * Arena::allocate(std::size_t size, std::size_t align)
+{
+    auto padding = [&](const std::byte * ptr) {
+        return (align - reinterpret_cast<std::uintptr_t>(ptr) % align) % align;
+    };
+
+    if (m_curr == nullptr || padding(m_curr) + size > m_left) {
+        // Oversized requests get their own block
+        std::size_t block_size = std::max(m_block_size, size + align);
+        m_blocks.emplace_back(std::make_unique<std::byte[]>(block_size));
+        m_curr = m_blocks.back().get();
+        m_left = block_size;
+    }
+
+    std::size_t pad = padding(m_curr);
+    std::byte * res = m_curr + pad;
+    m_curr += pad + size;
+    m_left -= pad + size;
+    m_allocated += size;
+    return res;
+}
+
+} // namespace util
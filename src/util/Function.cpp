@@ -1,15 +1,250 @@
 #include "util/Function.h"
+#include "util/FunctionPasses.h"
 
 #include <cmath>
+#include <cstddef>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <numeric>
+#include <optional>
 
+namespace {
+
+thread_local util::Arena * curr_arena = nullptr;
+
+// Every node is prefixed with the arena it was allocated from (nullptr for heap)
+constexpr std::size_t NodeHeaderSize = alignof(std::max_align_t);
+
+} // anonymous namespace
+
+void * Fn::operator new(std::size_t size)
+{
+    void * mem = curr_arena
+        ? curr_arena->allocate(size + NodeHeaderSize)
+        : ::operator new(size + NodeHeaderSize);
+    *static_cast<util::Arena **>(mem) = curr_arena;
+    return static_cast<std::byte *>(mem) + NodeHeaderSize;
+}
+
+void Fn::operator delete(void * ptr) noexcept
+{
+    if (ptr == nullptr) {
+        return;
+    }
+    void * mem = static_cast<std::byte *>(ptr) - NodeHeaderSize;
+    if (*static_cast<util::Arena **>(mem) == nullptr) {
+        ::operator delete(mem);
+    }
+    // arena memory is freed with the arena
+}
+
+Fn::ArenaScope::ArenaScope(util::Arena & arena)
+    : m_prev(curr_arena)
+{
+    curr_arena = &arena;
+}
+
+Fn::ArenaScope::~ArenaScope()
+{
+    curr_arena = m_prev;
+}
+
+const Fn & Fn::child(unsigned idx) const noexcept
+{
+    assert(false && "Node has no children");
+    return *this;
+}
+
+Func<1> Fn::grad(SimplifyStats * stats) const noexcept
+{
+    return partial_grad(dims(), stats);
+}
+
+Func<1> Fn::partial_grad(unsigned vars, SimplifyStats * stats) const noexcept
+{
+    assert(vars <= dims() && "Function has fewer variables");
+    std::vector<std::unique_ptr<Func<0>>> derivs(vars);
+    for (unsigned i = 0; i < vars; ++i) {
+        derivs[i] = simplify(*optimize_powers(*part_der(i)), stats);
+        derivs[i]->m_dims = dims();
+    }
+    return Func<1>(std::move(derivs));
+}
+
+auto Fn::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    // central difference with step scaled to the point
+    double step = 1e-7 * std::max(1., std::sqrt(util::length(x)));
+    double value = (*this)(x);
+    double forward = (*this)(util::add(x, util::mul(dir, step)));
+    double backward = (*this)(util::sub(x, util::mul(dir, step)));
+    return {value, (forward - backward) / (2 * step)};
+}
+
+void Fn::eval_batch(const double * xs, std::size_t count, double * out) const noexcept
+{
+    util::VectorT point(dims());
+    for (std::size_t k = 0; k < count; ++k) {
+        for (unsigned i = 0; i < dims(); ++i) {
+            point[i] = xs[i * count + k];
+        }
+        out[k] = (*this)(point);
+    }
+}
+
+namespace {
+
+thread_local std::vector<std::vector<double>> batch_buffers;
+
+} // anonymous namespace
+
+detail::BatchBuffer::BatchBuffer(std::size_t count)
+{
+    if (!batch_buffers.empty()) {
+        m_buf = std::move(batch_buffers.back());
+        batch_buffers.pop_back();
+    }
+    m_buf.resize(count);
+}
+
+detail::BatchBuffer::~BatchBuffer()
+{
+    batch_buffers.push_back(std::move(m_buf));
+}
+
+std::ostream & detail::print_base(std::ostream & out, const Fn & base)
+{
+    if (base.kind() == FnKind::Const && base.as_const() < 0.) {
+        return out << '(' << base << ')';
+    }
+    return out << base;
+}
 
 std::unique_ptr<Fn> cns(double value) { return std::make_unique<Const>(value); }
 std::unique_ptr<Fn> var(unsigned idx) { return std::make_unique<Variable>(idx); }
 
+namespace {
+
+bool is_sum_like(const Fn & fn)
+{
+    return fn.kind() == FnKind::Add || fn.kind() == FnKind::Sub || fn.kind() == FnKind::Sum;
+}
+
+bool is_product_like(const Fn & fn)
+{
+    return fn.kind() == FnKind::Mul || fn.kind() == FnKind::Product;
+}
+
+std::vector<std::unique_ptr<Fn>> operands(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r)
+{
+    std::vector<std::unique_ptr<Fn>> res;
+    res.reserve(2);
+    res.push_back(std::move(l));
+    res.push_back(std::move(r));
+    return res;
+}
+
+/*
+ * Flattened operands of "sum" and "product" builders
+ */
+struct SumParts
+{
+    std::vector<std::unique_ptr<Fn>> terms;
+    std::vector<double> coefs;
+    double constant = 0.;
+};
+
+struct ProductParts
+{
+    std::vector<std::unique_ptr<Fn>> factors;
+    double coef = 1.;
+};
+
+// Nested sums are merged, c * t adds t with coefficient c
+void append_term(SumParts & parts, std::unique_ptr<Fn> term, double coef)
+{
+    if (coef == 0.) {
+        return;
+    }
+    if (term->dims() == 0) {
+        parts.constant += coef * term->as_const();
+        return;
+    }
+
+    switch (term->kind()) {
+    case FnKind::Add:
+    case FnKind::Sub: {
+        double r_coef = term->kind() == FnKind::Add ? coef : -coef;
+        auto children = term->take_children();
+        append_term(parts, std::move(children[0]), coef);
+        append_term(parts, std::move(children[1]), r_coef);
+        return;
+    }
+    case FnKind::Sum: {
+        auto & sum_node = static_cast<Sum &>(*term);
+        parts.constant += coef * sum_node.constant();
+        auto children = sum_node.take_children();
+        auto coefs = sum_node.take_coefs();
+        if (parts.terms.empty() && coef == 1.) {
+            // terms of the first sum are already flattened, so they are taken as is:
+            // this makes building long sums by chained "add" linear
+            parts.terms = std::move(children);
+            parts.coefs = std::move(coefs);
+            return;
+        }
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            append_term(parts, std::move(children[i]), coef * coefs[i]);
+        }
+        return;
+    }
+    case FnKind::Mul:
+        for (unsigned i = 0; i < 2; ++i) {
+            if (term->child(i).dims() == 0) {
+                double factor = term->child(i).as_const();
+                append_term(parts, std::move(term->take_children()[1 - i]), coef * factor);
+                return;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    parts.terms.push_back(std::move(term));
+    parts.coefs.push_back(coef);
+}
+
+void append_factor(ProductParts & parts, std::unique_ptr<Fn> factor)
+{
+    if (factor->dims() == 0) {
+        parts.coef *= factor->as_const();
+        return;
+    }
+
+    switch (factor->kind()) {
+    case FnKind::Mul:
+    case FnKind::Product: {
+        if (factor->kind() == FnKind::Product) {
+            parts.coef *= static_cast<const Product &>(*factor).coef();
+            if (parts.factors.empty()) {
+                parts.factors = factor->take_children();
+                return;
+            }
+        }
+        for (auto & child : factor->take_children()) {
+            append_factor(parts, std::move(child));
+        }
+        return;
+    }
+    default:
+        parts.factors.push_back(std::move(factor));
+        return;
+    }
+}
+
+} // anonymous namespace
+
 std::unique_ptr<Fn> add(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r)
 {
     std::optional<double> l_as_const;
@@ -29,6 +264,10 @@ std::unique_ptr<Fn> add(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r)
             return cns(*l_as_const + cnst);
         }
     }
+
+    if (is_sum_like(*l) || is_sum_like(*r)) {
+        return sum(operands(std::move(l), std::move(r)), {1., 1.});
+    }
     return std::make_unique<Add>(std::move(l), std::move(r));
 }
 
@@ -45,6 +284,10 @@ std::unique_ptr<Fn> sub(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r)
     if (r_as_const && l->dims() == 0) {
         return cns(l->as_const() - *r_as_const);
     }
+
+    if (is_sum_like(*l) || is_sum_like(*r)) {
+        return sum(operands(std::move(l), std::move(r)), {1., -1.});
+    }
     return std::make_unique<Sub>(std::move(l), std::move(r));
 }
 
@@ -72,9 +315,70 @@ std::unique_ptr<Fn> mul(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r)
         }
     }
 
+    if (is_product_like(*l) || is_product_like(*r)) {
+        return product(operands(std::move(l), std::move(r)));
+    }
     return std::make_unique<Mul>(std::move(l), std::move(r));
 }
 
+std::unique_ptr<Fn> sum(std::vector<std::unique_ptr<Fn>> terms, std::vector<double> coefs, double constant)
+{
+    assert(terms.size() == coefs.size());
+
+    SumParts parts;
+    parts.constant = constant;
+    parts.terms.reserve(terms.size());
+    parts.coefs.reserve(terms.size());
+    for (std::size_t i = 0; i < terms.size(); ++i) {
+        append_term(parts, std::move(terms[i]), coefs[i]);
+    }
+
+    if (parts.terms.empty()) {
+        return cns(parts.constant);
+    }
+    if (parts.terms.size() == 1 && parts.constant == 0.) {
+        return mul(cns(parts.coefs[0]), std::move(parts.terms[0]));
+    }
+    return std::make_unique<Sum>(std::move(parts.terms), std::move(parts.coefs), parts.constant);
+}
+
+std::unique_ptr<Fn> product(std::vector<std::unique_ptr<Fn>> factors, double coef)
+{
+    ProductParts parts;
+    parts.coef = coef;
+    for (auto & factor : factors) {
+        append_factor(parts, std::move(factor));
+    }
+
+    if (parts.coef == 0. || parts.factors.empty()) {
+        return cns(parts.coef);
+    }
+    if (parts.factors.size() == 1) {
+        // c * f is kept binary, so sums take c as coefficient of f
+        if (parts.coef == 1.) {
+            return std::move(parts.factors[0]);
+        }
+        return std::make_unique<Mul>(cns(parts.coef), std::move(parts.factors[0]));
+    }
+    return std::make_unique<Product>(std::move(parts.factors), parts.coef);
+}
+
+std::unique_ptr<Fn> div(std::unique_ptr<Fn> l, std::unique_ptr<Fn> r)
+{
+    if (r->dims() == 0) {
+        double cnst = r->as_const();
+        if (cnst == 1.) {
+            return std::move(l);
+        }
+        return mul(std::move(l), cns(1. / cnst));
+    }
+
+    if (l->dims() == 0 && l->as_const() == 0.) {
+        return cns(0.);
+    }
+    return std::make_unique<Div>(std::move(l), std::move(r));
+}
+
 std::unique_ptr<Fn> pow(std::unique_ptr<Fn> base, int p)
 {
     if (p == 0) {
@@ -90,6 +394,36 @@ std::unique_ptr<Fn> pow(std::unique_ptr<Fn> base, int p)
     return std::make_unique<Pow>(std::move(base), p);
 }
 
+std::unique_ptr<Fn> pow(std::unique_ptr<Fn> base, double p)
+{
+    if (std::trunc(p) == p && std::abs(p) <= std::numeric_limits<int>::max()) {
+        return pow(std::move(base), static_cast<int>(p));
+    }
+
+    if (base->dims() == 0) {
+        return cns(std::pow(base->as_const(), p));
+    }
+
+    return std::make_unique<RealPow>(std::move(base), p);
+}
+
+#define M(type, builder) \
+    std::unique_ptr<Fn> builder(std::unique_ptr<Fn> arg) \
+    { \
+        if (arg->dims() == 0) { \
+            return cns(std::builder(arg->as_const())); \
+        } \
+        return std::make_unique<type>(std::move(arg)); \
+    }
+
+M(Exp, exp)
+M(Log, log)
+M(Sqrt, sqrt)
+M(Sin, sin)
+M(Cos, cos)
+
+#undef M
+
 
 std::unique_ptr<Fn> Const::part_der(unsigned idx) const noexcept
 {
@@ -126,10 +460,330 @@ std::unique_ptr<Fn> Mul::part_der(unsigned idx) const noexcept
     auto l_gr = m_l->part_der(idx);
     auto r_gr = m_r->part_der(idx);
 
-    return (m_l->part_der(idx) * m_r->clone()) + (m_l->clone() * m_r->part_der(idx));
+    return (std::move(l_gr) * m_r->clone()) + (m_l->clone() * std::move(r_gr));
+}
+
+std::unique_ptr<Fn> Div::part_der(unsigned idx) const noexcept
+{
+    auto l_gr = m_l->part_der(idx);
+    auto r_gr = m_r->part_der(idx);
+
+    if (r_gr->dims() == 0 && r_gr->as_const() == 0.) {
+        return std::move(l_gr) / m_r->clone();
+    }
+    return ((std::move(l_gr) * m_r->clone()) - (m_l->clone() * std::move(r_gr))) / (m_r->clone() ^ 2);
+}
+
+namespace {
+
+unsigned max_dims(const std::vector<std::unique_ptr<Fn>> & children)
+{
+    unsigned res = 0;
+    for (const auto & child : children) {
+        res = std::max(res, child->dims());
+    }
+    return res;
+}
+
+std::vector<std::unique_ptr<Fn>> clone_all(const std::vector<std::unique_ptr<Fn>> & children)
+{
+    std::vector<std::unique_ptr<Fn>> res;
+    res.reserve(children.size());
+    for (const auto & child : children) {
+        res.push_back(child->clone());
+    }
+    return res;
+}
+
+void print_coef(std::ostream & out, double coef, bool is_first)
+{
+    if (is_first) {
+        if (coef != 1.) {
+            out << coef << " * ";
+        }
+    } else {
+        out << (coef < 0. ? " - " : " + ");
+        if (std::abs(coef) != 1.) {
+            out << std::abs(coef) << " * ";
+        }
+    }
+}
+
+} // anonymous namespace
+
+Sum::Sum(std::vector<std::unique_ptr<Fn>> terms, std::vector<double> coefs, double constant)
+    : Fn(max_dims(terms))
+    , m_terms(std::move(terms))
+    , m_coefs(std::move(coefs))
+    , m_constant(constant)
+{}
+
+std::unique_ptr<Fn> Sum::clone() const noexcept
+{
+    return std::make_unique<Sum>(clone_all(m_terms), m_coefs, m_constant);
+}
+
+void Sum::eval_batch(const double * xs, std::size_t count, double * out) const noexcept
+{
+    detail::BatchBuffer term_res(count);
+    double * term_data = term_res.data();
+
+    std::fill_n(out, count, m_constant);
+    for (std::size_t i = 0; i < m_terms.size(); ++i) {
+        m_terms[i]->eval_batch(xs, count, term_data);
+        double coef = m_coefs[i];
+#pragma omp simd
+        for (std::size_t k = 0; k < count; ++k) {
+            out[k] += coef * term_data[k];
+        }
+    }
+}
+
+auto Sum::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    Dual res{m_constant, 0.};
+    for (std::size_t i = 0; i < m_terms.size(); ++i) {
+        auto term = m_terms[i]->eval_dual(x, dir);
+        res.value += m_coefs[i] * term.value;
+        res.der += m_coefs[i] * term.der;
+    }
+    return res;
+}
+
+std::unique_ptr<Fn> Sum::part_der(unsigned idx) const noexcept
+{
+    std::vector<std::unique_ptr<Fn>> ders;
+    ders.reserve(m_terms.size());
+    for (const auto & term : m_terms) {
+        ders.push_back(term->part_der(idx));
+    }
+    return sum(std::move(ders), m_coefs);
+}
+
+std::ostream & Sum::print(std::ostream & out) const
+{
+    out << '(';
+    for (std::size_t i = 0; i < m_terms.size(); ++i) {
+        print_coef(out, m_coefs[i], i == 0);
+        out << *m_terms[i];
+    }
+    if (m_constant != 0.) {
+        out << (m_constant < 0. ? " - " : " + ") << std::abs(m_constant);
+    }
+    return out << ')';
+}
+
+Product::Product(std::vector<std::unique_ptr<Fn>> factors, double coef)
+    : Fn(max_dims(factors))
+    , m_factors(std::move(factors))
+    , m_coef(coef)
+{}
+
+std::unique_ptr<Fn> Product::clone() const noexcept
+{
+    return std::make_unique<Product>(clone_all(m_factors), m_coef);
+}
+
+void Product::eval_batch(const double * xs, std::size_t count, double * out) const noexcept
+{
+    detail::BatchBuffer factor_res(count);
+    double * factor_data = factor_res.data();
+
+    m_factors[0]->eval_batch(xs, count, out);
+    for (std::size_t i = 1; i < m_factors.size(); ++i) {
+        m_factors[i]->eval_batch(xs, count, factor_data);
+#pragma omp simd
+        for (std::size_t k = 0; k < count; ++k) {
+            out[k] *= factor_data[k];
+        }
+    }
+
+    double coef = m_coef;
+#pragma omp simd
+    for (std::size_t k = 0; k < count; ++k) {
+        out[k] *= coef;
+    }
+}
+
+auto Product::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    // product rule applied factor by factor: (u * v)' = u' * v + u * v'
+    Dual res{m_coef, 0.};
+    for (const auto & factor : m_factors) {
+        auto f = factor->eval_dual(x, dir);
+        res.der = res.der * f.value + res.value * f.der;
+        res.value *= f.value;
+    }
+    return res;
+}
+
+std::unique_ptr<Fn> Product::part_der(unsigned idx) const noexcept
+{
+    // sum over factors of products with one factor differentiated
+    std::vector<std::unique_ptr<Fn>> terms;
+    for (std::size_t i = 0; i < m_factors.size(); ++i) {
+        auto der = m_factors[i]->part_der(idx);
+        if (der->dims() == 0 && der->as_const() == 0.) {
+            continue;
+        }
+
+        std::vector<std::unique_ptr<Fn>> factors;
+        factors.reserve(m_factors.size());
+        for (std::size_t j = 0; j < m_factors.size(); ++j) {
+            factors.push_back(i == j ? std::move(der) : m_factors[j]->clone());
+        }
+        terms.push_back(product(std::move(factors), m_coef));
+    }
+    std::vector<double> coefs(terms.size(), 1.);
+    return sum(std::move(terms), std::move(coefs));
+}
+
+std::ostream & Product::print(std::ostream & out) const
+{
+    out << '(';
+    if (m_coef != 1.) {
+        out << m_coef << " * ";
+    }
+    for (std::size_t i = 0; i < m_factors.size(); ++i) {
+        out << (i == 0 ? "" : " * ") << *m_factors[i];
+    }
+    return out << ')';
 }
 
 std::unique_ptr<Fn> Pow::part_der(unsigned idx) const noexcept
 {
     return cns(m_pow) * m_base->part_der(idx) * (m_base->clone() ^ (m_pow - 1));
 }
+
+void Pow::eval_batch(const double * xs, std::size_t count, double * out) const noexcept
+{
+    detail::BatchBuffer scratch(count);
+    m_base->eval_batch(xs, count, out);
+    util::simd::ipow(out, count, m_pow, scratch.data());
+}
+
+auto Pow::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto base = m_base->eval_dual(x, dir);
+    // value is computed as by operator(), so it's also inf or 1 in zero for non-positive powers
+    double der = m_pow == 0 || base.der == 0. ? 0. : m_pow * util::simd::ipow(base.value, m_pow - 1) * base.der;
+    return {util::simd::ipow(base.value, m_pow), der};
+}
+
+std::vector<std::unique_ptr<Fn>> Pow::take_children() noexcept
+{
+    std::vector<std::unique_ptr<Fn>> res;
+    res.push_back(std::move(m_base));
+    return res;
+}
+
+std::unique_ptr<Fn> RealPow::part_der(unsigned idx) const noexcept
+{
+    return cns(m_pow) * m_base->part_der(idx) * (m_base->clone() ^ (m_pow - 1));
+}
+
+void RealPow::eval_batch(const double * xs, std::size_t count, double * out) const noexcept
+{
+    m_base->eval_batch(xs, count, out);
+    util::simd::pow(out, count, m_pow);
+}
+
+auto RealPow::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto base = m_base->eval_dual(x, dir);
+    double der = base.der == 0. ? 0. : m_pow * std::pow(base.value, m_pow - 1) * base.der;
+    return {std::pow(base.value, m_pow), der};
+}
+
+std::vector<std::unique_ptr<Fn>> RealPow::take_children() noexcept
+{
+    std::vector<std::unique_ptr<Fn>> res;
+    res.push_back(std::move(m_base));
+    return res;
+}
+
+std::unique_ptr<Fn> Exp::part_der(unsigned idx) const noexcept
+{
+    return m_arg->part_der(idx) * exp(m_arg->clone());
+}
+
+std::unique_ptr<Fn> Log::part_der(unsigned idx) const noexcept
+{
+    return m_arg->part_der(idx) / m_arg->clone();
+}
+
+std::unique_ptr<Fn> Sqrt::part_der(unsigned idx) const noexcept
+{
+    return (0.5 * m_arg->part_der(idx)) / sqrt(m_arg->clone());
+}
+
+std::unique_ptr<Fn> Sin::part_der(unsigned idx) const noexcept
+{
+    return m_arg->part_der(idx) * cos(m_arg->clone());
+}
+
+std::unique_ptr<Fn> Cos::part_der(unsigned idx) const noexcept
+{
+    return (-1. * m_arg->part_der(idx)) * sin(m_arg->clone());
+}
+
+auto Add::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto l = m_l->eval_dual(x, dir);
+    auto r = m_r->eval_dual(x, dir);
+    return {l.value + r.value, l.der + r.der};
+}
+
+auto Sub::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto l = m_l->eval_dual(x, dir);
+    auto r = m_r->eval_dual(x, dir);
+    return {l.value - r.value, l.der - r.der};
+}
+
+auto Mul::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto l = m_l->eval_dual(x, dir);
+    auto r = m_r->eval_dual(x, dir);
+    return {l.value * r.value, l.der * r.value + l.value * r.der};
+}
+
+auto Div::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto l = m_l->eval_dual(x, dir);
+    auto r = m_r->eval_dual(x, dir);
+    double value = l.value / r.value;
+    return {value, (l.der - value * r.der) / r.value};
+}
+
+auto Exp::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto arg = m_arg->eval_dual(x, dir);
+    double value = std::exp(arg.value);
+    return {value, value * arg.der};
+}
+
+auto Log::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto arg = m_arg->eval_dual(x, dir);
+    return {std::log(arg.value), arg.der / arg.value};
+}
+
+auto Sqrt::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto arg = m_arg->eval_dual(x, dir);
+    double value = std::sqrt(arg.value);
+    return {value, 0.5 * arg.der / value};
+}
+
+auto Sin::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto arg = m_arg->eval_dual(x, dir);
+    return {std::sin(arg.value), std::cos(arg.value) * arg.der};
+}
+
+auto Cos::eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept -> Dual
+{
+    auto arg = m_arg->eval_dual(x, dir);
+    return {std::cos(arg.value), -std::sin(arg.value) * arg.der};
+}
@@ -0,0 +1,335 @@
+#include "util/FunctionParser.h"
+
+#include "util/MappedFile.h"
+
+#include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+namespace {
+
+/*
+ * Recursive descent parser:
+ *  expr    := term (("+" | "-") term)*
+ *  term    := unary (("*" | "/") unary)*
+ *  unary   := "-" unary | power
+ *  power   := primary ("^" number)?
+ *  primary := number | variable | name "(" expr ")" | "(" expr ")"
+ * so "-x ^ 2" is "-(x ^ 2)". Every rule returns nullptr on error.
+ */
+struct Parser
+{
+    // Parsed pages of the file are released in chunks of this size
+    static constexpr std::size_t ReleaseChunk = 1 << 20;
+
+    Parser(std::string_view text, const MappedFile * file = nullptr)
+        : m_text(text)
+        , m_file(file)
+    {}
+
+    std::unique_ptr<Fn> parse()
+    {
+        auto res = expr();
+        skip_spaces();
+        if (res && m_pos != m_text.size()) {
+            return fail("unexpected symbol");
+        }
+        return res;
+    }
+
+    std::string error() const
+    {
+        return m_error + " at offset " + std::to_string(m_error_pos);
+    }
+
+    // Text before this offset is released
+    std::size_t released() const noexcept { return m_released; }
+
+private:
+    std::unique_ptr<Fn> expr()
+    {
+        auto first = term();
+        if (!first || !next_is('+', '-')) {
+            return first;
+        }
+        double first_sign = m_text[m_pos++] == '+' ? 1. : -1.;
+        auto second = term();
+        if (!second) {
+            return nullptr;
+        }
+        // most sums have two terms, they are built without temporary vectors
+        if (!next_is('+', '-')) {
+            return first_sign > 0. ? add(std::move(first), std::move(second)) : sub(std::move(first), std::move(second));
+        }
+
+        // longer sums are built at once, not by chained "add"
+        std::vector<std::unique_ptr<Fn>> terms;
+        std::vector<double> coefs{1., first_sign};
+        terms.push_back(std::move(first));
+        terms.push_back(std::move(second));
+
+        while (next_is('+', '-')) {
+            double sign = m_text[m_pos++] == '+' ? 1. : -1.;
+            auto next = term();
+            if (!next) {
+                return nullptr;
+            }
+            terms.push_back(std::move(next));
+            coefs.push_back(sign);
+        }
+        return sum(std::move(terms), std::move(coefs));
+    }
+
+    std::unique_ptr<Fn> term()
+    {
+        auto res = unary();
+        if (!res || !next_is('*', '/')) {
+            return res;
+        }
+
+        std::vector<std::unique_ptr<Fn>> factors;
+        while (next_is('*', '/')) {
+            bool is_div = m_text[m_pos++] == '/';
+            auto next = unary();
+            if (!next) {
+                return nullptr;
+            }
+            if (is_div) {
+                if (!factors.empty()) {
+                    factors.push_back(std::move(res));
+                    res = product(std::move(factors));
+                    factors.clear();
+                }
+                res = div(std::move(res), std::move(next));
+            } else {
+                factors.push_back(std::move(res));
+                res = std::move(next);
+            }
+        }
+
+        if (factors.empty()) {
+            return res;
+        }
+        if (factors.size() == 1) {
+            return mul(std::move(factors.front()), std::move(res));
+        }
+        factors.push_back(std::move(res));
+        return product(std::move(factors));
+    }
+
+    std::unique_ptr<Fn> power()
+    {
+        auto base = primary();
+        if (!base) {
+            return nullptr;
+        }
+
+        if (next_is('^', '^')) {
+            ++m_pos;
+            skip_spaces();
+            double exponent;
+            if (!number(exponent)) {
+                return fail("numeric exponent expected");
+            }
+            return pow(std::move(base), exponent);
+        }
+        return base;
+    }
+
+    std::unique_ptr<Fn> unary()
+    {
+        skip_spaces();
+        if (m_pos < m_text.size() && m_text[m_pos] == '-') {
+            // negative numbers are read as constants, not as negation, unless they are raised to a power
+            std::size_t minus_pos = m_pos;
+            double value;
+            if (number(value) && !next_is('^', '^')) {
+                return cns(value);
+            }
+            m_pos = minus_pos + 1;
+            auto arg = unary();
+            if (!arg) {
+                return nullptr;
+            }
+            return mul(cns(-1.), std::move(arg));
+        }
+        return power();
+    }
+
+    std::unique_ptr<Fn> primary()
+    {
+        skip_spaces();
+        if (m_pos == m_text.size()) {
+            return fail("unexpected end of text");
+        }
+
+        char curr = m_text[m_pos];
+        if (curr == '(') {
+            ++m_pos;
+            auto res = expr();
+            if (!res) {
+                return nullptr;
+            }
+            return close_paren() ? std::move(res) : nullptr;
+        }
+
+        if (is_digit(curr) || curr == '.') {
+            double value;
+            if (!number(value)) {
+                return fail("invalid number");
+            }
+            return cns(value);
+        }
+
+        std::size_t name_begin = m_pos;
+        while (m_pos < m_text.size() && is_alnum(m_text[m_pos])) {
+            ++m_pos;
+        }
+        std::string_view name = m_text.substr(name_begin, m_pos - name_begin);
+
+        if (name.size() > 1 && name[0] == 'x') {
+            unsigned idx;
+            auto [end, ec] = std::from_chars(name.data() + 1, name.data() + name.size(), idx);
+            if (ec == std::errc() && end == name.data() + name.size()) {
+                return var(idx);
+            }
+        }
+
+        using Builder = std::unique_ptr<Fn> (*)(std::unique_ptr<Fn>);
+        Builder builder = nullptr;
+        if (name == "exp") {
+            builder = exp;
+        } else if (name == "log") {
+            builder = log;
+        } else if (name == "sqrt") {
+            builder = sqrt;
+        } else if (name == "sin") {
+            builder = sin;
+        } else if (name == "cos") {
+            builder = cos;
+        } else {
+            m_pos = name_begin;
+            return fail(name.empty() ? "unexpected symbol" : "unknown name");
+        }
+
+        skip_spaces();
+        if (m_pos == m_text.size() || m_text[m_pos] != '(') {
+            return fail("'(' expected");
+        }
+        ++m_pos;
+        auto arg = expr();
+        if (!arg || !close_paren()) {
+            return nullptr;
+        }
+        return builder(std::move(arg));
+    }
+
+    bool close_paren()
+    {
+        skip_spaces();
+        if (m_pos == m_text.size() || m_text[m_pos] != ')') {
+            fail("')' expected");
+            return false;
+        }
+        ++m_pos;
+        return true;
+    }
+
+    // Reads number with optional sign, position is not moved on failure
+    bool number(double & value)
+    {
+        const char * begin = m_text.data() + m_pos;
+        const char * end = m_text.data() + m_text.size();
+        auto [num_end, ec] = std::from_chars(begin, end, value);
+        if (ec != std::errc()) {
+            return false;
+        }
+        m_pos += num_end - begin;
+        return true;
+    }
+
+    // Skips spaces and checks, that the next symbol is "first" or "second"
+    bool next_is(char first, char second)
+    {
+        skip_spaces();
+        return m_pos < m_text.size() && (m_text[m_pos] == first || m_text[m_pos] == second);
+    }
+
+    /*
+     * Called before every token, so parsed pages are released at any depth of parentheses
+     * (Fn::print puts every sum in them). Nothing refers to text before the current position.
+     */
+    void skip_spaces()
+    {
+        while (m_pos < m_text.size() && is_space(m_text[m_pos])) {
+            ++m_pos;
+        }
+        if (m_file != nullptr && m_pos >= m_released + ReleaseChunk) {
+            m_file->release_before(m_pos);
+            m_released = m_pos;
+        }
+    }
+
+    // Locale-independent character classes
+    static bool is_space(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+    static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    static bool is_alnum(char c) { return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+    std::unique_ptr<Fn> fail(const char * message)
+    {
+        if (m_error.empty()) {
+            m_error = message;
+            m_error_pos = m_pos;
+        }
+        return nullptr;
+    }
+
+private:
+    std::string_view m_text;
+    std::size_t m_pos = 0;
+
+    const MappedFile * m_file;
+    std::size_t m_released = 0;
+
+    std::string m_error;
+    std::size_t m_error_pos = 0;
+};
+
+} // anonymous namespace
+
+std::unique_ptr<Fn> parse_function(std::string_view text, std::string * error)
+{
+    Parser parser(text);
+    auto res = parser.parse();
+    if (!res && error) {
+        *error = parser.error();
+    }
+    return res;
+}
+
+std::unique_ptr<Fn> load_function(const std::string & path, std::string * error)
+{
+    auto file = MappedFile::open(path);
+    if (!file) {
+        if (error) {
+            *error = "cannot open " + path;
+        }
+        return nullptr;
+    }
+    file->advise_sequential();
+
+    Parser parser(std::string_view(file->data(), file->size()), &*file);
+    auto res = parser.parse();
+    // every token passes Parser::skip_spaces, so a model spanning several chunks can't stay in memory
+    assert((!res || file->size() < 2 * Parser::ReleaseChunk || parser.released() > 0) && "Parsed pages are not released");
+    if (!res && error) {
+        *error = parser.error();
+    }
+    return res;
+}
+
+} // namespace util
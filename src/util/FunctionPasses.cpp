@@ -0,0 +1,403 @@
+#include "util/FunctionPasses.h"
+
+#include "util/Misc.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+int compare(const Fn & lhs, const Fn & rhs)
+{
+    if (&lhs == &rhs) {
+        return 0;
+    }
+    if (lhs.kind() != rhs.kind()) {
+        return lhs.kind() < rhs.kind() ? -1 : 1;
+    }
+    if (lhs.kind() == FnKind::Custom) {
+        return std::less<const Fn *>()(&lhs, &rhs) ? -1 : 1;
+    }
+
+    auto cmp = [](auto l, auto r) { return l < r ? -1 : (r < l ? 1 : 0); };
+    int res = lhs.call_func(util::overload(
+        [&](const Const & cnst) { return cmp(cnst.value, static_cast<const Const &>(rhs).value); },
+        [&](const Variable & var) { return cmp(var.index, static_cast<const Variable &>(rhs).index); },
+        [&](const Pow & pow) { return cmp(pow.power(), static_cast<const Pow &>(rhs).power()); },
+        [&](const RealPow & pow) { return cmp(pow.power(), static_cast<const RealPow &>(rhs).power()); },
+        [&](const Sum & sum) {
+            const auto & other = static_cast<const Sum &>(rhs);
+            int res = cmp(sum.coefs(), other.coefs());
+            return res != 0 ? res : cmp(sum.constant(), other.constant());
+        },
+        [&](const Product & prod) { return cmp(prod.coef(), static_cast<const Product &>(rhs).coef()); },
+        [](const Fn &) { return 0; }
+    ));
+    if (res != 0 || (res = cmp(lhs.child_cnt(), rhs.child_cnt())) != 0) {
+        return res;
+    }
+
+    for (unsigned i = 0; i < lhs.child_cnt(); ++i) {
+        if ((res = compare(lhs.child(i), rhs.child(i))) != 0) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+unsigned node_count(const Fn & fn)
+{
+    unsigned res = 1;
+    for (unsigned i = 0; i < fn.child_cnt(); ++i) {
+        res += node_count(fn.child(i));
+    }
+    return res;
+}
+
+namespace {
+
+std::unique_ptr<Fn> fold_powers_rule(std::unique_ptr<Fn> node);
+
+bool is_const(const Fn & fn, double value)
+{
+    return fn.kind() == FnKind::Const && static_cast<const Const &>(fn).value == value;
+}
+
+// Split node into base and integer power: b ^ p -> (b, p), any other b -> (b, 1)
+std::pair<std::unique_ptr<Fn>, int> as_power(std::unique_ptr<Fn> fn)
+{
+    if (fn->kind() != FnKind::Pow) {
+        return {std::move(fn), 1};
+    }
+    int power = static_cast<const Pow &>(*fn).power();
+    return {std::move(fn->take_children()[0]), power};
+}
+
+std::unique_ptr<Fn> fold_power(std::unique_ptr<Fn> node)
+{
+    const auto & pow_node = static_cast<const Pow &>(*node);
+
+    if (pow_node.base().kind() == FnKind::Pow) {
+        // (b ^ p) ^ q -> b ^ (p * q)
+        int outer = pow_node.power();
+        auto [base, inner] = as_power(std::move(node->take_children()[0]));
+        return fold_powers_rule(pow(std::move(base), inner * outer));
+    }
+    if (pow_node.power() < 0) {
+        // b ^ -p -> 1 / b ^ p
+        int power = -pow_node.power();
+        return div(cns(1.), pow(std::move(node->take_children()[0]), power));
+    }
+    return node;
+}
+
+std::unique_ptr<Fn> fold_mul(std::unique_ptr<Fn> node)
+{
+    const auto & mul_node = static_cast<const Mul &>(*node);
+
+    // l * (1 / r) -> l / r
+    for (unsigned i = 0; i < 2; ++i) {
+        const Fn & factor = mul_node.child(i);
+        if (factor.kind() == FnKind::Div && is_const(factor.child(0), 1.)) {
+            auto children = node->take_children();
+            auto denom = std::move(children[i]->take_children()[1]);
+            return div(std::move(children[1 - i]), std::move(denom));
+        }
+    }
+
+    // b ^ p * b ^ q -> b ^ (p + q)
+    auto base_of = [](const Fn & fn) -> const Fn & {
+        return fn.kind() == FnKind::Pow ? static_cast<const Pow &>(fn).base() : fn;
+    };
+    if (equal(base_of(mul_node.lhs()), base_of(mul_node.rhs()))) {
+        auto children = node->take_children();
+        auto [base, l_pow] = as_power(std::move(children[0]));
+        int r_pow = as_power(std::move(children[1])).second;
+        return fold_powers_rule(pow(std::move(base), l_pow + r_pow));
+    }
+    return node;
+}
+
+std::unique_ptr<Fn> fold_powers_rule(std::unique_ptr<Fn> node)
+{
+    switch (node->kind()) {
+    case FnKind::Pow:
+        return fold_power(std::move(node));
+    case FnKind::Mul:
+        return fold_mul(std::move(node));
+    default:
+        return node;
+    }
+}
+
+} // anonymous namespace
+
+std::unique_ptr<Fn> optimize_powers(const Fn & fn)
+{
+    return rewrite(fn, fold_powers_rule);
+}
+
+namespace {
+
+/*
+ * Flattened sum: constant + coef_1 * term_1 + ... + coef_n * term_n
+ */
+struct SumForm
+{
+    double constant = 0.;
+    std::vector<std::pair<double, std::unique_ptr<Fn>>> terms;
+};
+
+/*
+ * Flattened product: coef * factor_1 ^ power_1 * ... * factor_n ^ power_n
+ */
+struct ProductForm
+{
+    double coef = 1.;
+    std::vector<std::pair<std::unique_ptr<Fn>, int>> factors;
+};
+
+std::unique_ptr<Fn> simplify_node(const Fn & fn, bool nested);
+
+// Split simplified term into constant coefficient and the rest: c * t -> (c, t)
+std::pair<double, std::unique_ptr<Fn>> split_coef(std::unique_ptr<Fn> term)
+{
+    if (term->kind() == FnKind::Mul && static_cast<const Mul &>(*term).lhs().kind() == FnKind::Const) {
+        double coef = static_cast<const Const &>(static_cast<const Mul &>(*term).lhs()).value;
+        return {coef, std::move(term->take_children()[1])};
+    }
+    if (term->kind() == FnKind::Product) {
+        double coef = static_cast<const Product &>(*term).coef();
+        return {coef, product(term->take_children())};
+    }
+    return {1., std::move(term)};
+}
+
+// Add already simplified term (which can be a sum itself) with coefficient "sign"
+void add_simplified_term(SumForm & form, std::unique_ptr<Fn> term, double sign)
+{
+    switch (term->kind()) {
+    case FnKind::Const:
+        form.constant += sign * static_cast<const Const &>(*term).value;
+        return;
+    case FnKind::Add:
+    case FnKind::Sub: {
+        double r_sign = term->kind() == FnKind::Add ? sign : -sign;
+        auto children = term->take_children();
+        add_simplified_term(form, std::move(children[0]), sign);
+        add_simplified_term(form, std::move(children[1]), r_sign);
+        return;
+    }
+    case FnKind::Sum: {
+        const auto & sum_node = static_cast<const Sum &>(*term);
+        auto coefs = sum_node.coefs();
+        form.constant += sign * sum_node.constant();
+        auto children = term->take_children();
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            add_simplified_term(form, std::move(children[i]), sign * coefs[i]);
+        }
+        return;
+    }
+    default: {
+        auto [coef, rest] = split_coef(std::move(term));
+        form.terms.emplace_back(sign * coef, std::move(rest));
+        return;
+    }
+    }
+}
+
+// Walk through sum in the original tree, simplifying only its terms
+void collect_sum(SumForm & form, const Fn & fn, double sign)
+{
+    switch (fn.kind()) {
+    case FnKind::Add:
+    case FnKind::Sub:
+        collect_sum(form, fn.child(0), sign);
+        collect_sum(form, fn.child(1), fn.kind() == FnKind::Add ? sign : -sign);
+        return;
+    case FnKind::Sum: {
+        const auto & sum_node = static_cast<const Sum &>(fn);
+        form.constant += sign * sum_node.constant();
+        for (unsigned i = 0; i < fn.child_cnt(); ++i) {
+            collect_sum(form, fn.child(i), sign * sum_node.coefs()[i]);
+        }
+        return;
+    }
+    default:
+        add_simplified_term(form, simplify_node(fn, true), sign);
+        return;
+    }
+}
+
+std::unique_ptr<Fn> build_sum(SumForm form, bool normalize_sign)
+{
+    // sort terms to canonical order and collect like ones
+    std::stable_sort(form.terms.begin(), form.terms.end(), [](const auto & l, const auto & r) {
+        return compare(*l.second, *r.second) < 0;
+    });
+
+    std::vector<std::pair<double, std::unique_ptr<Fn>>> collected;
+    for (auto & term : form.terms) {
+        if (!collected.empty() && equal(*collected.back().second, *term.second)) {
+            collected.back().first += term.first;
+        } else {
+            collected.push_back(std::move(term));
+        }
+    }
+
+    collected.erase(
+        std::remove_if(collected.begin(), collected.end(), [](const auto & term) { return term.first == 0.; }),
+        collected.end());
+
+    // Sign of nested sums is normalized, so that a - b and b - a are collected
+    // as like terms too: b - a -> -1 * (a - b)
+    bool is_single_term = collected.size() == 1 && form.constant == 0.;
+    double sign = 1.;
+    if (normalize_sign && !is_single_term && !collected.empty() && collected.front().first < 0.) {
+        sign = -1.;
+        form.constant = -form.constant;
+        for (auto & term : collected) {
+            term.first = -term.first;
+        }
+    }
+
+    std::vector<std::unique_ptr<Fn>> terms;
+    std::vector<double> coefs;
+    terms.reserve(collected.size());
+    coefs.reserve(collected.size());
+    for (auto & [coef, term] : collected) {
+        coefs.push_back(coef);
+        terms.push_back(std::move(term));
+    }
+    return cns(sign) * sum(std::move(terms), std::move(coefs), form.constant);
+}
+
+// Add already simplified factor (which can be a product itself) with power "power"
+void add_simplified_factor(ProductForm & form, std::unique_ptr<Fn> factor, int power)
+{
+    switch (factor->kind()) {
+    case FnKind::Const:
+        form.coef *= util::simd::ipow(static_cast<const Const &>(*factor).value, power);
+        return;
+    case FnKind::Mul:
+    case FnKind::Div: {
+        int r_power = factor->kind() == FnKind::Mul ? power : -power;
+        auto children = factor->take_children();
+        add_simplified_factor(form, std::move(children[0]), power);
+        add_simplified_factor(form, std::move(children[1]), r_power);
+        return;
+    }
+    case FnKind::Product: {
+        form.coef *= util::simd::ipow(static_cast<const Product &>(*factor).coef(), power);
+        for (auto & child : factor->take_children()) {
+            add_simplified_factor(form, std::move(child), power);
+        }
+        return;
+    }
+    case FnKind::Pow: {
+        int inner = static_cast<const Pow &>(*factor).power();
+        add_simplified_factor(form, std::move(factor->take_children()[0]), inner * power);
+        return;
+    }
+    default:
+        form.factors.emplace_back(std::move(factor), power);
+        return;
+    }
+}
+
+// Walk through product in the original tree, simplifying only its factors
+void collect_product(ProductForm & form, const Fn & fn, int power)
+{
+    switch (fn.kind()) {
+    case FnKind::Mul:
+    case FnKind::Div:
+        collect_product(form, fn.child(0), power);
+        collect_product(form, fn.child(1), fn.kind() == FnKind::Mul ? power : -power);
+        return;
+    case FnKind::Product:
+        form.coef *= util::simd::ipow(static_cast<const Product &>(fn).coef(), power);
+        for (unsigned i = 0; i < fn.child_cnt(); ++i) {
+            collect_product(form, fn.child(i), power);
+        }
+        return;
+    case FnKind::Pow:
+        collect_product(form, fn.child(0), power * static_cast<const Pow &>(fn).power());
+        return;
+    default:
+        add_simplified_factor(form, simplify_node(fn, true), power);
+        return;
+    }
+}
+
+std::unique_ptr<Fn> build_product(ProductForm form)
+{
+    if (form.coef == 0.) {
+        return cns(0.);
+    }
+
+    // sort factors to canonical order and collect like ones
+    std::stable_sort(form.factors.begin(), form.factors.end(), [](const auto & l, const auto & r) {
+        return compare(*l.first, *r.first) < 0;
+    });
+
+    std::vector<std::unique_ptr<Fn>> num;
+    std::vector<std::unique_ptr<Fn>> den;
+    for (std::size_t i = 0; i < form.factors.size();) {
+        int power = form.factors[i].second;
+        std::size_t j = i + 1;
+        for (; j < form.factors.size() && equal(*form.factors[i].first, *form.factors[j].first); ++j) {
+            power += form.factors[j].second;
+        }
+
+        auto & factor = form.factors[i].first;
+        if (power > 0) {
+            num.push_back(pow(std::move(factor), power));
+        } else if (power < 0) {
+            den.push_back(pow(std::move(factor), -power));
+        }
+        i = j;
+    }
+
+    // coefficient is kept outermost, so sums are able to collect like terms
+    return cns(form.coef) * (product(std::move(num)) / product(std::move(den)));
+}
+
+std::unique_ptr<Fn> simplify_node(const Fn & fn, bool nested)
+{
+    switch (fn.kind()) {
+    case FnKind::Add:
+    case FnKind::Sub:
+    case FnKind::Sum: {
+        SumForm form;
+        collect_sum(form, fn, 1.);
+        return build_sum(std::move(form), nested);
+    }
+    case FnKind::Mul:
+    case FnKind::Div:
+    case FnKind::Product:
+    case FnKind::Pow: {
+        ProductForm form;
+        collect_product(form, fn, 1);
+        return build_product(std::move(form));
+    }
+    default: {
+        std::vector<std::unique_ptr<Fn>> children;
+        children.reserve(fn.child_cnt());
+        for (unsigned i = 0; i < fn.child_cnt(); ++i) {
+            children.push_back(simplify_node(fn.child(i), false));
+        }
+        return fn.with_children(std::move(children));
+    }
+    }
+}
+
+} // anonymous namespace
+
+std::unique_ptr<Fn> simplify(const Fn & fn, SimplifyStats * stats)
+{
+    auto res = simplify_node(fn, false);
+    if (stats) {
+        stats->nodes_before += node_count(fn);
+        stats->nodes_after += node_count(*res);
+    }
+    return res;
+}
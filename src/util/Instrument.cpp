@@ -0,0 +1,54 @@
+#include "util/Instrument.h"
+
+#include <iomanip>
+#include <thread>
+
+namespace util {
+
+const char * phase_name(Phase phase) noexcept
+{
+    switch (phase) {
+        case Phase::Func: return "func";
+        case Phase::Grad: return "grad";
+        case Phase::Hessian: return "hessian";
+        case Phase::LinearSolve: return "linear solve";
+        case Phase::LineSearch: return "line search";
+        case Phase::Update: return "update";
+        case Phase::Count: break;
+    }
+    return "";
+}
+
+double ticks_per_ms()
+{
+    static const double res = [] {
+        using Clock = std::chrono::steady_clock;
+        auto start_time = Clock::now();
+        auto start_ticks = read_ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto ticks = read_ticks() - start_ticks;
+        return ticks / std::chrono::duration<double, std::milli>(Clock::now() - start_time).count();
+    }();
+    return res;
+}
+
+std::ostream & operator<<(std::ostream & out, const SearchStats & stats)
+{
+    if constexpr (!InstrumentEnabled) {
+        return out << "Instrumentation is disabled, build with NEWTONE_INSTRUMENT\n";
+    }
+
+    out << "Iterations: " << stats.iterations().size() << '\n';
+    out << std::left << std::setw(14) << "phase" << std::right << std::setw(12) << "calls" << std::setw(12) << "ms" << '\n';
+    for (std::size_t i = 0; i < PhaseCount; ++i) {
+        auto phase = static_cast<Phase>(i);
+        const auto & entry = stats.total()[phase];
+        out << std::left << std::setw(14) << phase_name(phase)
+            << std::right << std::setw(12) << entry.calls
+            << std::setw(12) << std::fixed << std::setprecision(3) << entry.ticks / ticks_per_ms()
+            << std::defaultfloat << '\n';
+    }
+    return out;
+}
+
+} // namespace util
@@ -0,0 +1,148 @@
+#include "util/MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace util {
+
+std::optional<MappedFile> MappedFile::open(const std::string & path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    std::size_t size = st.st_size;
+    if (size == 0) {
+        ::close(fd);
+        return MappedFile(nullptr, 0);
+    }
+
+    void * mem = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // mapping stays valid without descriptor
+    if (mem == MAP_FAILED) {
+        return std::nullopt;
+    }
+    return MappedFile(static_cast<const char *>(mem), size);
+}
+
+MappedFile::MappedFile(MappedFile && other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+{}
+
+MappedFile & MappedFile::operator=(MappedFile && other) noexcept
+{
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+}
+
+void MappedFile::advise_sequential() const noexcept
+{
+    if (m_data != nullptr) {
+        ::madvise(const_cast<char *>(m_data), m_size, MADV_SEQUENTIAL);
+    }
+}
+
+void MappedFile::release_before(std::size_t offset) const noexcept
+{
+    // only whole pages are released
+    std::size_t page = ::sysconf(_SC_PAGESIZE);
+    std::size_t len = std::min(offset, m_size) / page * page;
+    if (m_data != nullptr && len > 0) {
+        ::madvise(const_cast<char *>(m_data), len, MADV_DONTNEED);
+    }
+}
+
+std::optional<MappedOutput> MappedOutput::create(const std::string & path)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    return MappedOutput(fd);
+}
+
+MappedOutput::MappedOutput(MappedOutput && other) noexcept
+    : m_fd(std::exchange(other.m_fd, -1))
+    , m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_capacity(std::exchange(other.m_capacity, 0))
+{}
+
+MappedOutput & MappedOutput::operator=(MappedOutput && other) noexcept
+{
+    std::swap(m_fd, other.m_fd);
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_capacity, other.m_capacity);
+    return *this;
+}
+
+MappedOutput::~MappedOutput()
+{
+    close();
+}
+
+char * MappedOutput::append(std::size_t bytes) noexcept
+{
+    if (m_size + bytes > m_capacity) {
+        // mapping grows twice, so appends are amortized O(1)
+        std::size_t capacity = std::max({m_capacity * 2, m_size + bytes, std::size_t{1} << 20});
+        if (::ftruncate(m_fd, capacity) != 0) {
+            return nullptr;
+        }
+        void * mem = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (mem == MAP_FAILED) {
+            return nullptr;
+        }
+        if (m_data != nullptr) {
+            ::munmap(m_data, m_capacity);
+        }
+        m_data = static_cast<char *>(mem);
+        m_capacity = capacity;
+    }
+
+    char * res = m_data + m_size;
+    m_size += bytes;
+    return res;
+}
+
+void MappedOutput::rewind(std::size_t size) noexcept
+{
+    m_size = std::min(m_size, size);
+}
+
+void MappedOutput::close() noexcept
+{
+    if (m_data != nullptr) {
+        ::munmap(m_data, m_capacity);
+        m_data = nullptr;
+    }
+    if (m_fd >= 0) {
+        [[maybe_unused]] int res = ::ftruncate(m_fd, m_size);
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+} // namespace util
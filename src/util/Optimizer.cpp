@@ -0,0 +1,137 @@
+#include "util/Optimizer.h"
+
+#include <cmath>
+
+namespace util {
+
+namespace {
+
+// Gradient's length by directional derivatives along coordinates, gradient's tree is not built
+double grad_length(const Function & func, const VectorT & x)
+{
+    VectorT dir(x.size(), 0.);
+    double res = 0.;
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        dir[i] = 1.;
+        double der = func.eval_dual(x, dir).der;
+        res += der * der;
+        dir[i] = 0.;
+    }
+    return std::sqrt(res);
+}
+
+} // anonymous namespace
+
+const char * stop_reason_name(StopReason reason) noexcept
+{
+    switch (reason) {
+        case StopReason::None: return "none";
+        case StopReason::GradientNorm: return "gradient norm";
+        case StopReason::StepSize: return "step size";
+        case StopReason::MaxIterations: return "max iterations";
+        case StopReason::MaxEvaluations: return "max evaluations";
+        case StopReason::TimeLimit: return "time limit";
+        case StopReason::NotFinite: return "not finite";
+        case StopReason::LineSearchFailed: return "line search failed";
+    }
+    return "";
+}
+
+std::ostream & operator<<(std::ostream & out, const SearchResult & result)
+{
+    out << "Stopped by: " << stop_reason_name(result.reason) << '\n';
+    out << "f(x) = " << result.value << ", |grad| = " << result.grad_norm << '\n';
+    out << "Iterations: " << result.iterations << '\n';
+    out << "Evaluations: func " << result.func_evals << ", grad " << result.grad_evals << ", hessian " << result.hessian_evals << '\n';
+    return out << "Time: " << result.time_ms << " ms\n";
+}
+
+StopReason progress_reason(const StopCriteria & criteria, double step, double grad_norm) noexcept
+{
+    if (std::isnan(step) || std::isinf(grad_norm) || std::isnan(grad_norm)) {
+        return StopReason::NotFinite;
+    } else if (grad_norm >= 0. && grad_norm < criteria.grad_norm) {
+        return StopReason::GradientNorm;
+    } else if (step < criteria.step) {
+        return StopReason::StepSize;
+    }
+    return StopReason::None;
+}
+
+void Termination::start(const StopCriteria & criteria)
+{
+    m_criteria = criteria;
+    m_reason = StopReason::None;
+    m_grad_norm = -1.;
+    m_iterations = 0;
+    m_counters = thread_counters();
+    m_start = Clock::now();
+}
+
+bool Termination::stop_on_progress(double step, double grad_norm)
+{
+    m_reason = progress_reason(m_criteria, step, grad_norm);
+    // searchers stop at the point, which gradient is checked, so it's the gradient of the result
+    m_grad_norm = m_reason != StopReason::None ? grad_norm : -1.;
+    return m_reason != StopReason::None;
+}
+
+bool Termination::stop_on_limits(unsigned iterations)
+{
+    m_iterations = iterations;
+    if (m_criteria.max_iterations != 0 && iterations >= m_criteria.max_iterations) {
+        m_reason = StopReason::MaxIterations;
+        return true;
+    }
+    if (m_criteria.max_evaluations != 0) {
+        auto done = counters();
+        if (done[Phase::Func].calls + done[Phase::Grad].calls + done[Phase::Hessian].calls >= m_criteria.max_evaluations) {
+            m_reason = StopReason::MaxEvaluations;
+            return true;
+        }
+    }
+    if (m_criteria.time_limit_ms != 0. && elapsed_ms() >= m_criteria.time_limit_ms) {
+        m_reason = StopReason::TimeLimit;
+        return true;
+    }
+    return false;
+}
+
+double Termination::elapsed_ms() const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+}
+
+VectorT Optimizer::initial_point(unsigned dims, VectorT init) const
+{
+    if (!init.empty()) {
+        return init;
+    }
+    if (auto warm = warm_state(dims)) {
+        return warm->point;
+    }
+    return VectorT(dims, 0.);
+}
+
+SearchResult Optimizer::minimize(const Function & func, VectorT init)
+{
+    SearchResult res;
+    res.point = minimize_impl(func, std::move(init));
+
+    auto done = m_termination.counters();
+    res.time_ms = m_termination.elapsed_ms();
+    res.iterations = m_termination.iterations();
+    res.reason = m_termination.reason();
+    res.func_evals = done[Phase::Func].calls;
+    res.grad_evals = done[Phase::Grad].calls;
+    res.hessian_evals = done[Phase::Hessian].calls;
+
+    res.value = func(res.point);
+    res.grad_norm = m_termination.grad_norm();
+    if (!(res.grad_norm >= 0.)) {
+        res.grad_norm = grad_length(func, res.point);
+    }
+    return res;
+}
+
+} // namespace util
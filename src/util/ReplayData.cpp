@@ -0,0 +1,171 @@
+#include "util/ReplayData.h"
+
+#include "util/TraceExporter.h"
+
+#include <algorithm>
+
+namespace util {
+
+namespace {
+
+constexpr char TraceMagic[8] = {'N', 'W', 'T', 'T', 'R', 'A', 'C', 'E'};
+constexpr std::uint64_t TraceFormatVersion = 1;
+
+} // anonymous namespace
+
+std::uint64_t * ReplayData::grow(std::size_t count)
+{
+    if (m_file) {
+        return reinterpret_cast<std::uint64_t *>(m_file->append(count * sizeof(std::uint64_t)));
+    }
+    std::size_t old_size = m_words.size();
+    m_words.resize(old_size + count);
+    return m_words.data() + old_size;
+}
+
+auto ReplayData::add_record(std::uint32_t kind, uint version, std::uint64_t size, std::uint64_t payload, std::size_t extra_words) -> Record *
+{
+    auto * res = reinterpret_cast<Record *>(grow(RecordWords + extra_words));
+    if (res != nullptr) {
+        *res = {kind, version, size, payload};
+    }
+    return res;
+}
+
+void ReplayData::publish(const Record * record)
+{
+    if (m_exporter != nullptr && record != nullptr) {
+        m_exporter->push(reinterpret_cast<const std::uint64_t *>(record), record_words(*record));
+    }
+}
+
+void ReplayData::add_point(uint version, const double * coords, std::size_t size)
+{
+    if (auto * record = add_record(static_cast<std::uint32_t>(VdDataKind::VdPointKind), version, size, 0, size)) {
+        std::copy(coords, coords + size, reinterpret_cast<double *>(record + 1));
+        publish(record);
+    }
+}
+
+void ReplayData::add_value(uint version, double val)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    publish(add_record(static_cast<std::uint32_t>(VdDataKind::VdValueKind), version, 0, bits));
+}
+
+void ReplayData::add_comment(uint version, std::string_view comment)
+{
+    // there are only few distinct comments, so linear search is the fastest
+    auto it = std::find(m_comments.begin(), m_comments.end(), comment);
+    std::size_t id = it - m_comments.begin();
+    if (it == m_comments.end()) {
+        std::size_t text_words = (comment.size() + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+        auto * record = add_record(CommentText, version, comment.size(), id, text_words);
+        if (record == nullptr) {
+            return;
+        }
+        std::memcpy(record + 1, comment.data(), comment.size());
+        m_comments.emplace_back(comment);
+        publish(record);
+    }
+    publish(add_record(static_cast<std::uint32_t>(VdDataKind::VdCommentKind), version, 0, id));
+}
+
+bool ReplayData::stream_to(const std::string & path)
+{
+    auto file = MappedOutput::create(path);
+    if (!file) {
+        return false;
+    }
+    auto * header = reinterpret_cast<FileHeader *>(file->append(sizeof(FileHeader)));
+    char * written = header ? file->append(size_bytes()) : nullptr;
+    if (written == nullptr) {
+        return false;
+    }
+    // pointer to header could be invalidated by the second append
+    header = reinterpret_cast<FileHeader *>(file->data());
+    std::memcpy(header->magic, TraceMagic, sizeof(TraceMagic));
+    header->format_version = TraceFormatVersion;
+    std::memcpy(written, m_words.data(), size_bytes());
+
+    m_file = std::move(file);
+    m_words = {};
+    return true;
+}
+
+void ReplayData::stop_streaming()
+{
+    m_file.reset();
+    m_comments.clear();
+}
+
+void ReplayData::clear()
+{
+    if (m_file) {
+        m_file->rewind(sizeof(FileHeader));
+    }
+    m_words.clear();
+    m_comments.clear();
+}
+
+ReplayReader::ReplayReader(MappedFile file)
+    : m_file(std::move(file))
+{}
+
+std::optional<ReplayReader> ReplayReader::open(const std::string & path)
+{
+    auto file = MappedFile::open(path);
+    using Header = ReplayData::FileHeader;
+    if (!file || file->size() < sizeof(Header) || file->size() % sizeof(std::uint64_t) != 0) {
+        return std::nullopt;
+    }
+    const auto * header = reinterpret_cast<const Header *>(file->data());
+    if (std::memcmp(header->magic, TraceMagic, sizeof(TraceMagic)) != 0 || header->format_version != TraceFormatVersion) {
+        return std::nullopt;
+    }
+    file->advise_sequential();
+
+    ReplayReader res(std::move(*file));
+    res.m_words = reinterpret_cast<const std::uint64_t *>(res.m_file.data()) + ReplayData::HeaderWords;
+    res.m_word_cnt = res.m_file.size() / sizeof(std::uint64_t) - ReplayData::HeaderWords;
+
+    // Validate records and collect comments, so iteration doesn't need any checks
+    for (std::size_t pos = 0; pos < res.m_word_cnt;) {
+        if (res.m_word_cnt - pos < ReplayData::RecordWords) {
+            return std::nullopt;
+        }
+        const auto & record = *reinterpret_cast<const ReplayData::Record *>(res.m_words + pos);
+        switch (record.kind) {
+        case static_cast<std::uint32_t>(VdDataKind::VdPointKind):
+            if (record.size > res.m_word_cnt) {
+                return std::nullopt;
+            }
+            break;
+        case static_cast<std::uint32_t>(VdDataKind::VdValueKind):
+            break;
+        case static_cast<std::uint32_t>(VdDataKind::VdCommentKind):
+            if (record.payload >= res.m_comments.size()) {
+                return std::nullopt;
+            }
+            break;
+        case ReplayData::CommentText:
+            if (record.payload != res.m_comments.size() || record.size > (res.m_word_cnt - pos) * sizeof(std::uint64_t)) {
+                return std::nullopt;
+            }
+            res.m_comments.emplace_back(reinterpret_cast<const char *>(&record + 1), record.size);
+            break;
+        default:
+            return std::nullopt;
+        }
+
+        std::size_t words = ReplayData::record_words(record);
+        if (words > res.m_word_cnt - pos) {
+            return std::nullopt;
+        }
+        pos += words;
+    }
+    return res;
+}
+
+} // namespace util
@@ -0,0 +1,101 @@
+#include "util/SearchState.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace util {
+
+namespace {
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dims;
+    std::uint32_t has_curvature;
+    std::uint32_t reserved;
+    double step;
+    double der;
+};
+
+constexpr char Magic[8] = {'N', 'W', 'T', 'S', 'T', 'A', 'T', 'E'};
+constexpr std::uint32_t Version = 1;
+
+bool read_doubles(std::istream & in, VectorT & out, std::size_t count)
+{
+    out.resize(count);
+    in.read(reinterpret_cast<char *>(out.data()), count * sizeof(double));
+    return static_cast<bool>(in);
+}
+
+void write_doubles(std::ostream & out, const VectorT & values)
+{
+    out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(double));
+}
+
+} // anonymous namespace
+
+std::optional<SearchState> SearchState::load(const std::string & path)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    const auto file_size = static_cast<std::uint64_t>(std::max<std::streamoff>(in.tellg(), 0));
+    in.seekg(0);
+    Header header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        return std::nullopt;
+    }
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.has_curvature > 1) {
+        return std::nullopt;
+    }
+    // Size of the state is checked against file size before anything is allocated,
+    // dimensions are checked before multiplying them, so it does not overflow
+    const std::uint64_t data_size = file_size - sizeof(Header);
+    const std::uint64_t available = data_size / sizeof(double);
+    if (data_size % sizeof(double) != 0 || header.dims > available
+            || (header.has_curvature && header.dims != 0 && header.dims > available / header.dims)
+            || std::uint64_t{header.dims} * (1 + std::uint64_t{header.has_curvature} * header.dims) != available) {
+        return std::nullopt;
+    }
+
+    SearchState res;
+    res.step = header.step;
+    res.der = header.der;
+    if (!read_doubles(in, res.point, header.dims)) {
+        return std::nullopt;
+    }
+    if (header.has_curvature) {
+        res.curvature.resize(header.dims);
+        for (auto & row : res.curvature) {
+            if (!read_doubles(in, row, header.dims)) {
+                return std::nullopt;
+            }
+        }
+    }
+    return res;
+}
+
+bool SearchState::save(const std::string & path) const
+{
+    assert((curvature.empty() || curvature.size() == dims()) && "Curvature doesn't match point");
+
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.dims = dims();
+    header.has_curvature = !curvature.empty();
+    header.step = step;
+    header.der = der;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_doubles(out, point);
+    for (const auto & row : curvature) {
+        write_doubles(out, row);
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace util
@@ -0,0 +1,510 @@
+#include "util/Tape.h"
+
+#include "util/Arena.h"
+#include "util/Misc.h"
+#include "util/SimdKernels.h"
+#include "util/VectorOps.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+namespace util {
+
+struct Tape::Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dims;
+    std::uint64_t instr_cnt;
+    std::uint64_t value_end;        // instructions needed for function value
+    std::uint64_t grad_end;         // instructions needed for gradient
+    std::uint64_t value_slot;
+    std::uint64_t hessian_nnz;
+};
+
+namespace {
+
+constexpr char Magic[8] = {'N', 'W', 'T', 'T', 'A', 'P', 'E', '\0'};
+constexpr std::uint32_t Version = 1;
+
+using Op = Tape::Op;
+using Instr = Tape::Instr;
+
+// Offsets of image parts
+struct Layout
+{
+    std::size_t instrs;
+    std::size_t grad_slots;
+    std::size_t hessian;
+    std::size_t size;
+
+    Layout(std::size_t dims, std::size_t instr_cnt, std::size_t hessian_nnz)
+        : instrs(sizeof(Tape::Header))
+        , grad_slots(instrs + instr_cnt * sizeof(Instr))
+        , hessian(grad_slots + dims * sizeof(std::uint32_t))
+        , size(hessian + hessian_nnz * sizeof(Tape::HessianEntry))
+    {}
+};
+
+struct InstrHash
+{
+    std::size_t operator()(const Instr & instr) const noexcept
+    {
+        std::uint64_t imm;
+        std::memcpy(&imm, &instr.imm, sizeof(imm));
+        std::size_t res = static_cast<std::size_t>(instr.op);
+        for (std::uint64_t part : {std::uint64_t{instr.lhs}, std::uint64_t{instr.rhs}, imm}) {
+            res ^= std::hash<std::uint64_t>()(part) + 0x9e3779b97f4a7c15ULL + (res << 6) + (res >> 2);
+        }
+        return res;
+    }
+};
+
+struct InstrEqual
+{
+    bool operator()(const Instr & lhs, const Instr & rhs) const noexcept
+    {
+        return lhs.op == rhs.op && lhs.lhs == rhs.lhs && lhs.rhs == rhs.rhs
+            && std::memcmp(&lhs.imm, &rhs.imm, sizeof(double)) == 0;
+    }
+};
+
+/*
+ * Emits instructions for expression trees, equal instructions are emitted once
+ */
+struct TapeBuilder
+{
+    std::vector<Instr> instrs;
+    bool failed = false;
+
+    std::uint32_t emit(Op op, std::uint32_t lhs = 0, std::uint32_t rhs = 0, double imm = 0.)
+    {
+        // operands of commutative operations are ordered, so a + b and b + a are equal
+        if ((op == Op::Add || op == Op::Mul) && lhs > rhs) {
+            std::swap(lhs, rhs);
+        }
+        Instr instr{op, lhs, rhs, 0, imm};
+        auto [it, inserted] = m_slots.try_emplace(instr, instrs.size());
+        if (inserted) {
+            instrs.push_back(instr);
+        }
+        return it->second;
+    }
+
+    std::uint32_t add(const Fn & fn)
+    {
+        auto binary = [&](Op op, const Fn & lhs, const Fn & rhs) {
+            std::uint32_t l = add(lhs);
+            std::uint32_t r = add(rhs);
+            return emit(op, l, r);
+        };
+        auto unary = [&](Op op, const Fn & arg, double imm = 0.) {
+            return emit(op, add(arg), 0, imm);
+        };
+
+        return fn.call_func(util::overload(
+            [&](const Const & cnst) { return emit(Op::Const, 0, 0, cnst.value); },
+            [&](const Variable & var) { return emit(Op::Var, var.index); },
+            [&](const Add & node) { return binary(Op::Add, node.lhs(), node.rhs()); },
+            [&](const Sub & node) { return binary(Op::Sub, node.lhs(), node.rhs()); },
+            [&](const Mul & node) { return binary(Op::Mul, node.lhs(), node.rhs()); },
+            [&](const Div & node) { return binary(Op::Div, node.lhs(), node.rhs()); },
+            [&](const Sum & node) {
+                std::uint32_t res = emit(Op::Const, 0, 0, node.constant());
+                for (unsigned i = 0; i < node.child_cnt(); ++i) {
+                    res = emit(Op::AddScaled, res, add(node.child(i)), node.coefs()[i]);
+                }
+                return res;
+            },
+            [&](const Product & node) {
+                std::uint32_t res = add(node.child(0));
+                for (unsigned i = 1; i < node.child_cnt(); ++i) {
+                    res = emit(Op::Mul, res, add(node.child(i)));
+                }
+                return node.coef() == 1. ? res : emit(Op::Scale, res, 0, node.coef());
+            },
+            [&](const Pow & node) { return unary(Op::Pow, node.base(), node.power()); },
+            [&](const RealPow & node) { return unary(Op::RealPow, node.base(), node.power()); },
+            [&](const Exp & node) { return unary(Op::Exp, node.arg()); },
+            [&](const Log & node) { return unary(Op::Log, node.arg()); },
+            [&](const Sqrt & node) { return unary(Op::Sqrt, node.arg()); },
+            [&](const Sin & node) { return unary(Op::Sin, node.arg()); },
+            [&](const Cos & node) { return unary(Op::Cos, node.arg()); },
+            [&](const Fn &) {
+                failed = true;
+                return std::uint32_t{0};
+            }
+        ));
+    }
+
+private:
+    std::unordered_map<Instr, std::uint32_t, InstrHash, InstrEqual> m_slots;
+};
+
+bool is_zero(const Fn & fn)
+{
+    return fn.dims() == 0 && fn.as_const() == 0.;
+}
+
+// Operands of instruction must be computed before it, integer power must fit into int
+bool is_valid(const Instr & instr, std::size_t slot, unsigned dims)
+{
+    switch (instr.op) {
+    case Op::Const:
+        return true;
+    case Op::Var:
+        return instr.lhs < dims;
+    case Op::Add:
+    case Op::Sub:
+    case Op::Mul:
+    case Op::Div:
+    case Op::AddScaled:
+        return instr.lhs < slot && instr.rhs < slot;
+    case Op::Pow:
+        return instr.lhs < slot && std::isfinite(instr.imm) && std::trunc(instr.imm) == instr.imm
+            && instr.imm >= std::numeric_limits<int>::min() && instr.imm <= std::numeric_limits<int>::max();
+    case Op::Scale:
+    case Op::RealPow:
+    case Op::Exp:
+    case Op::Log:
+    case Op::Sqrt:
+    case Op::Sin:
+    case Op::Cos:
+        return instr.lhs < slot;
+    }
+    return false;
+}
+
+thread_local std::vector<double> registers;
+
+} // anonymous namespace
+
+/*
+ * Evaluates function value (order 0), gradient entry (order 1) or hessian entry (order 2) of the tape.
+ * Operands precede their results, so running the tape up to the slot is enough.
+ */
+struct Tape::Node : Fn
+{
+    Node(const Tape & tape, std::size_t slot, unsigned order, unsigned row)
+        : Fn(tape.dims())
+        , m_tape(tape.share())
+        , m_slot(slot)
+        , m_order(order)
+        , m_row(row)
+    {}
+
+    Node(const Node & other)
+        : Node(other.m_tape, other.m_slot, other.m_order, other.m_row)
+    {}
+
+    double operator()(const util::VectorT & x) const noexcept override
+    {
+        return m_tape.run(x, m_slot + 1)[m_slot];
+    }
+
+    Dual eval_dual(const util::VectorT & x, const util::VectorT & dir) const noexcept override
+    {
+        if (m_order != 0) {
+            return Fn::eval_dual(x, dir);
+        }
+        thread_local util::VectorT grad;
+        double value = m_tape.eval(x, grad);
+        return {value, util::scalar(grad, dir)};
+    }
+
+    std::unique_ptr<Fn> part_der(unsigned idx) const noexcept override
+    {
+        if (m_order == 0) {
+            return std::make_unique<Node>(m_tape, m_tape.grad_slots()[idx], 1, idx);
+        }
+        if (m_order == 1) {
+            // only the lower triangle of hessian is stored, entries outside of the pattern are zero
+            unsigned row = std::max(m_row, idx), col = std::min(m_row, idx);
+            for (std::size_t i = 0; i < m_tape.hessian_nnz(); ++i) {
+                const auto & entry = m_tape.hessian_pattern()[i];
+                if (entry.row == row && entry.col == col) {
+                    return std::make_unique<Node>(m_tape, entry.slot, 2, row);
+                }
+            }
+            return cns(0.);
+        }
+        // third derivatives are not compiled
+        return cns(std::numeric_limits<double>::quiet_NaN());
+    }
+
+    std::unique_ptr<Fn> clone() const noexcept override { return std::make_unique<Node>(*this); }
+
+    std::ostream & print(std::ostream & out) const override { return out << "tape[" << m_slot << ']'; }
+
+    Tape m_tape;            // shares the image
+    std::size_t m_slot;
+    unsigned m_order;
+    unsigned m_row;         // of gradient entry
+};
+
+std::optional<Tape> Tape::compile(const Fn & fn)
+{
+    util::Arena arena;
+    Fn::ArenaScope scope(arena);
+
+    unsigned dims = fn.dims();
+    TapeBuilder builder;
+
+    std::uint32_t value_slot = builder.add(fn);
+    std::size_t value_end = builder.instrs.size();
+
+    auto grad = fn.grad();
+    std::vector<std::uint32_t> grad_slots(dims);
+    for (unsigned i = 0; i < dims; ++i) {
+        grad_slots[i] = builder.add(grad[i]);
+    }
+    std::size_t grad_end = builder.instrs.size();
+
+    std::vector<HessianEntry> hessian;
+    for (unsigned row = 0; row < dims; ++row) {
+        auto hessian_row = grad[row].grad();
+        for (unsigned col = 0; col <= row; ++col) {
+            if (!is_zero(hessian_row[col])) {
+                hessian.push_back({row, col, builder.add(hessian_row[col])});
+            }
+        }
+    }
+
+    if (builder.failed) {
+        return std::nullopt;
+    }
+
+    const auto & instrs = builder.instrs;
+    Layout layout(dims, instrs.size(), hessian.size());
+    std::vector<std::uint64_t> image((layout.size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+    auto * base = reinterpret_cast<char *>(image.data());
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.dims = dims;
+    header.instr_cnt = instrs.size();
+    header.value_end = value_end;
+    header.grad_end = grad_end;
+    header.value_slot = value_slot;
+    header.hessian_nnz = hessian.size();
+
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base + layout.instrs, instrs.data(), instrs.size() * sizeof(Instr));
+    std::memcpy(base + layout.grad_slots, grad_slots.data(), grad_slots.size() * sizeof(std::uint32_t));
+    std::memcpy(base + layout.hessian, hessian.data(), hessian.size() * sizeof(HessianEntry));
+
+    return Tape(std::move(image));
+}
+
+std::optional<Tape> Tape::load(const std::string & path)
+{
+    auto file = MappedFile::open(path);
+    if (!file || file->size() < sizeof(Header)) {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        return std::nullopt;
+    }
+    // counts are checked against file size before computing layout, so it does not overflow
+    if (header.instr_cnt > file->size() / sizeof(Instr)
+            || header.hessian_nnz > file->size() / sizeof(HessianEntry)
+            || Layout(header.dims, header.instr_cnt, header.hessian_nnz).size != file->size()) {
+        return std::nullopt;
+    }
+
+    Tape res(std::move(*file));
+
+    // Tape is used as is, only its indices and integer powers are checked
+    const Instr * code = res.instrs();
+    for (std::size_t i = 0; i < header.instr_cnt; ++i) {
+        if (!is_valid(code[i], i, header.dims)) {
+            return std::nullopt;
+        }
+    }
+    if (header.value_end > header.grad_end || header.grad_end > header.instr_cnt || header.value_slot >= header.value_end) {
+        return std::nullopt;
+    }
+    for (unsigned i = 0; i < header.dims; ++i) {
+        if (res.grad_slots()[i] >= header.grad_end) {
+            return std::nullopt;
+        }
+    }
+    for (std::size_t i = 0; i < header.hessian_nnz; ++i) {
+        const auto & entry = res.hessian_pattern()[i];
+        if (entry.row >= header.dims || entry.col > entry.row || entry.slot >= header.instr_cnt) {
+            return std::nullopt;
+        }
+    }
+    return res;
+}
+
+bool Tape::save(const std::string & path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(m_base, m_size);
+    return static_cast<bool>(out);
+}
+
+struct Tape::Image
+{
+    std::vector<std::uint64_t> words;       // owned image (8-byte aligned)
+    std::optional<MappedFile> file;         // or mapped one
+};
+
+Tape::Tape(std::vector<std::uint64_t> image)
+    : m_image(std::make_shared<Image>(Image{std::move(image), std::nullopt}))
+    , m_base(reinterpret_cast<const char *>(m_image->words.data()))
+    , m_size(Layout(header().dims, header().instr_cnt, header().hessian_nnz).size)
+{}
+
+Tape::Tape(MappedFile file)
+    : m_image(std::make_shared<Image>(Image{{}, std::move(file)}))
+    , m_base(m_image->file->data())
+    , m_size(m_image->file->size())
+{}
+
+Tape::Tape(std::shared_ptr<const Image> image, const char * base, std::size_t size)
+    : m_image(std::move(image))
+    , m_base(base)
+    , m_size(size)
+{}
+
+Tape Tape::share() const
+{
+    return Tape(m_image, m_base, m_size);
+}
+
+auto Tape::header() const noexcept -> const Header &
+{
+    return *reinterpret_cast<const Header *>(m_base);
+}
+
+auto Tape::instrs() const noexcept -> const Instr *
+{
+    return reinterpret_cast<const Instr *>(m_base + sizeof(Header));
+}
+
+const std::uint32_t * Tape::grad_slots() const noexcept
+{
+    return reinterpret_cast<const std::uint32_t *>(instrs() + header().instr_cnt);
+}
+
+unsigned Tape::dims() const noexcept { return header().dims; }
+std::size_t Tape::instr_cnt() const noexcept { return header().instr_cnt; }
+std::size_t Tape::hessian_nnz() const noexcept { return header().hessian_nnz; }
+
+auto Tape::hessian_pattern() const noexcept -> const HessianEntry *
+{
+    return reinterpret_cast<const HessianEntry *>(grad_slots() + header().dims);
+}
+
+const double * Tape::run(const util::VectorT & x, std::size_t last, std::size_t first) const noexcept
+{
+    assert(x.size() >= dims() && "Point has too few coordinates");
+
+    registers.resize(instr_cnt());
+    double * r = registers.data();
+    const Instr * code = instrs();
+
+    for (std::size_t i = first; i < last; ++i) {
+        const Instr & instr = code[i];
+        switch (instr.op) {
+        case Op::Const: r[i] = instr.imm; break;
+        case Op::Var: r[i] = x[instr.lhs]; break;
+        case Op::Add: r[i] = r[instr.lhs] + r[instr.rhs]; break;
+        case Op::Sub: r[i] = r[instr.lhs] - r[instr.rhs]; break;
+        case Op::Mul: r[i] = r[instr.lhs] * r[instr.rhs]; break;
+        case Op::Div: r[i] = r[instr.lhs] / r[instr.rhs]; break;
+        case Op::Scale: r[i] = instr.imm * r[instr.lhs]; break;
+        case Op::AddScaled: r[i] = r[instr.lhs] + instr.imm * r[instr.rhs]; break;
+        case Op::Pow: r[i] = util::simd::ipow(r[instr.lhs], static_cast<int>(instr.imm)); break;
+        case Op::RealPow: r[i] = std::pow(r[instr.lhs], instr.imm); break;
+        case Op::Exp: r[i] = std::exp(r[instr.lhs]); break;
+        case Op::Log: r[i] = std::log(r[instr.lhs]); break;
+        case Op::Sqrt: r[i] = std::sqrt(r[instr.lhs]); break;
+        case Op::Sin: r[i] = std::sin(r[instr.lhs]); break;
+        case Op::Cos: r[i] = std::cos(r[instr.lhs]); break;
+        }
+    }
+    return r;
+}
+
+double Tape::operator()(const util::VectorT & x) const noexcept
+{
+    return run(x, header().value_end)[header().value_slot];
+}
+
+double Tape::eval(const util::VectorT & x, util::VectorT & grad) const noexcept
+{
+    const double * r = run(x, header().grad_end);
+    grad.resize(dims());
+    for (unsigned i = 0; i < dims(); ++i) {
+        grad[i] = r[grad_slots()[i]];
+    }
+    return r[header().value_slot];
+}
+
+double Tape::eval(const util::VectorT & x, util::VectorT & grad, Matrix & hessian) const noexcept
+{
+    double res = eval(x, grad);
+    eval_hessian(x, hessian);
+    return res;
+}
+
+double Tape::eval(const util::VectorT & x, util::VectorT & grad, double * hessian) const noexcept
+{
+    double res = eval(x, grad);
+    eval_hessian(x, hessian);
+    return res;
+}
+
+void Tape::eval_hessian(const util::VectorT & x, Matrix & hessian) const noexcept
+{
+    const double * r = run(x, instr_cnt(), header().grad_end);
+    for (unsigned row = 0; row < dims(); ++row) {
+        for (unsigned col = 0; col < dims(); ++col) {
+            hessian.set(row, col, 0.);
+        }
+    }
+    for (std::size_t i = 0; i < hessian_nnz(); ++i) {
+        const auto & entry = hessian_pattern()[i];
+        hessian.set(entry.row, entry.col, r[entry.slot]);
+        hessian.set(entry.col, entry.row, r[entry.slot]);
+    }
+}
+
+void Tape::eval_hessian(const util::VectorT & x, double * hessian) const noexcept
+{
+    const double * r = run(x, instr_cnt(), header().grad_end);
+    std::fill(hessian, hessian + std::size_t{dims()} * dims(), 0.);
+    for (std::size_t i = 0; i < hessian_nnz(); ++i) {
+        const auto & entry = hessian_pattern()[i];
+        hessian[std::size_t{entry.row} * dims() + entry.col] = r[entry.slot];
+        hessian[std::size_t{entry.col} * dims() + entry.row] = r[entry.slot];
+    }
+}
+
+std::unique_ptr<Fn> Tape::function() const
+{
+    return std::make_unique<Node>(*this, header().value_slot, 0, 0);
+}
+
+const Tape * Tape::backing(const Fn & fn) noexcept
+{
+    const auto * node = dynamic_cast<const Node *>(&fn);
+    return node != nullptr && node->m_order == 0 ? &node->m_tape : nullptr;
+}
+
+} // namespace util
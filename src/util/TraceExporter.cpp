@@ -0,0 +1,327 @@
+#include "util/TraceExporter.h"
+
+#include "util/ReplayData.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+namespace util {
+
+namespace {
+
+// Header of .npy file is rewritten with the final shape, so its size is fixed
+constexpr std::size_t NpyHeaderSize = 128;
+
+void append_number(std::string & out, double value)
+{
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+}
+
+std::string npy_header(std::size_t rows, std::size_t cols)
+{
+    std::string dict = "{'descr': '<f8', 'fortran_order': False, 'shape': (" + std::to_string(rows) + ", " + std::to_string(cols) + "), }";
+    std::size_t dict_size = NpyHeaderSize - 10;
+    dict.resize(dict_size - 1, ' ');
+    dict += '\n';
+
+    std::string res = "\x93NUMPY";
+    res += '\x01';
+    res += '\x00';
+    res += static_cast<char>(dict_size & 0xff);
+    res += static_cast<char>(dict_size >> 8);
+    return res + dict;
+}
+
+/*
+ * Converts printed function to MATLAB expression over matrices X and Y:
+ * coordinates "x" and "y" of projection become X and Y, others are replaced by values from "point"
+ */
+std::string matlab_expression(const std::string & func, unsigned x, unsigned y, const std::vector<double> & point)
+{
+    auto is_alnum = [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; };
+
+    std::string res;
+    for (std::size_t i = 0; i < func.size();) {
+        if (func[i] == 'x' && (i == 0 || !is_alnum(func[i - 1]))) {
+            unsigned idx;
+            auto [end, ec] = std::from_chars(func.data() + i + 1, func.data() + func.size(), idx);
+            std::size_t next = end - func.data();
+            if (ec == std::errc() && (next == func.size() || !is_alnum(func[next]))) {
+                if (idx == x) {
+                    res += 'X';
+                } else if (idx == y) {
+                    res += 'Y';
+                } else {
+                    res += '(';
+                    append_number(res, idx < point.size() ? point[idx] : 0.);
+                    res += ')';
+                }
+                i = next;
+                continue;
+            }
+        }
+
+        // element-wise operators
+        if (i + 2 < func.size() && func[i] == ' ' && func[i + 2] == ' ' && (func[i + 1] == '^' || func[i + 1] == '/' || func[i + 1] == '*')) {
+            res += '.';
+            res += func[i + 1];
+            i += 3;
+            continue;
+        }
+        res += func[i++];
+    }
+    return res;
+}
+
+} // anonymous namespace
+
+std::unique_ptr<TraceExporter> TraceExporter::create(const std::string & path, Options options)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return nullptr;
+    }
+    std::unique_ptr<TraceExporter> res(new TraceExporter(std::move(out), std::move(options)));
+    res->m_thread = std::thread(&TraceExporter::run, res.get());
+    return res;
+}
+
+TraceExporter::TraceExporter(std::ofstream out, Options options)
+    : m_options(std::move(options))
+    , m_out(std::move(out))
+{
+    std::size_t capacity = 1024;
+    while (capacity < m_options.queue_words) {
+        capacity *= 2;
+    }
+    m_queue.resize(capacity);
+}
+
+TraceExporter::~TraceExporter()
+{
+    finish();
+}
+
+void TraceExporter::push(const std::uint64_t * words, std::size_t count)
+{
+    // a record larger than the queue is passed in parts, consumer collects them
+    std::size_t mask = m_queue.size() - 1;
+    while (count > 0) {
+        std::size_t part = std::min(count, m_queue.size());
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        while (head + part - m_tail.load(std::memory_order_acquire) > m_queue.size()) {
+            std::this_thread::yield();
+        }
+
+        std::size_t first = std::min(part, m_queue.size() - (head & mask));
+        std::copy(words, words + first, m_queue.data() + (head & mask));
+        std::copy(words + first, words + part, m_queue.data());
+        m_head.store(head + part, std::memory_order_release);
+        words += part;
+        count -= part;
+    }
+}
+
+void TraceExporter::finish()
+{
+    if (m_thread.joinable()) {
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+}
+
+void TraceExporter::run()
+{
+    write_header();
+    for (;;) {
+        // everything pushed before stop is set, is seen by the following consume
+        bool stop = m_stop.load(std::memory_order_acquire);
+        if (!consume()) {
+            if (stop) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    write_footer();
+    m_out.flush();
+}
+
+bool TraceExporter::consume()
+{
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    std::size_t head = m_head.load(std::memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+
+    std::size_t mask = m_queue.size() - 1;
+    auto copy_out = [&](std::size_t from, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            m_record.push_back(m_queue[(from + i) & mask]);
+        }
+    };
+
+    // record may be split between calls, if it's larger than the queue
+    auto record_words = [this] {
+        return m_record.size() < ReplayData::RecordWords
+                ? ReplayData::RecordWords
+                : ReplayData::record_words(*reinterpret_cast<const ReplayData::Record *>(m_record.data()));
+    };
+
+    while (tail != head) {
+        std::size_t part = std::min(record_words() - m_record.size(), head - tail);
+        copy_out(tail, part);
+        tail += part;
+        if (m_record.size() == record_words()) {
+            write_entry(m_record.data());
+            m_record.clear();
+        }
+        // space is returned after every part, so producer waits as little as possible
+        m_tail.store(tail, std::memory_order_release);
+    }
+    return true;
+}
+
+void TraceExporter::write_header()
+{
+    switch (m_options.format) {
+    case Format::Matlab: m_out << "points = [\n"; break;
+    case Format::Csv: m_out << "iter,name,values\n"; break;
+    case Format::Npy: m_out << npy_header(0, 1); break;
+    }
+}
+
+void TraceExporter::write_entry(const std::uint64_t * words)
+{
+    const auto & record = *reinterpret_cast<const ReplayData::Record *>(words);
+    const auto * data = words + ReplayData::RecordWords;
+
+    if (record.kind == ReplayData::CommentText) {
+        // ids restart from 0, when ReplayData is cleared for the next search
+        if (m_comments.size() <= record.payload) {
+            m_comments.resize(record.payload + 1);
+        }
+        m_comments[record.payload].assign(reinterpret_cast<const char *>(data), record.size);
+        return;
+    }
+
+    switch (static_cast<VdDataKind>(record.kind)) {
+    case VdDataKind::VdCommentKind:
+        m_label = record.payload < m_comments.size() ? m_comments[record.payload] : std::string{};
+        if (!m_label.empty() && m_label.back() == ':') {
+            m_label.pop_back();
+        }
+        return;
+
+    case VdDataKind::VdPointKind: {
+        const auto * coords = reinterpret_cast<const double *>(data);
+        std::size_t size = record.size;
+        if (m_dims == 0) {
+            m_dims = size;
+        }
+
+        m_line.clear();
+        if (m_options.format == Format::Csv) {
+            m_line += std::to_string(record.version) + ',' + (m_label.empty() ? "point" : m_label);
+            for (std::size_t i = 0; i < size; ++i) {
+                m_line += ',';
+                append_number(m_line, coords[i]);
+            }
+            m_line += '\n';
+            m_out << m_line;
+        } else if (size == m_dims) {
+            // matrix rows must have equal size, points of other dimensions are skipped
+            if (m_options.format == Format::Matlab) {
+                for (std::size_t i = 0; i < size; ++i) {
+                    append_number(m_line, coords[i]);
+                    m_line += (i + 1 == size ? ";\n" : " ");
+                }
+                m_out << m_line;
+
+                for (std::size_t k = 0; k < 2; ++k) {
+                    double val = m_options.projection[k] < size ? coords[m_options.projection[k]] : 0.;
+                    m_min[k] = m_rows == 0 ? val : std::min(m_min[k], val);
+                    m_max[k] = m_rows == 0 ? val : std::max(m_max[k], val);
+                }
+                m_last_point.assign(coords, coords + size);
+            } else {
+                double iter = record.version;
+                m_out.write(reinterpret_cast<const char *>(&iter), sizeof(iter));
+                m_out.write(reinterpret_cast<const char *>(coords), size * sizeof(double));
+            }
+            ++m_rows;
+        }
+        m_label.clear();
+        return;
+    }
+
+    case VdDataKind::VdValueKind: {
+        double value;
+        std::memcpy(&value, &record.payload, sizeof(value));
+        std::string name = m_label.empty() ? "values" : m_label;
+        if (m_options.format == Format::Csv) {
+            m_line = std::to_string(record.version) + ',' + name + ',';
+            append_number(m_line, value);
+            m_line += '\n';
+            m_out << m_line;
+        } else if (m_options.format == Format::Matlab) {
+            // values are few, they are written after points
+            auto it = std::find_if(m_values.begin(), m_values.end(), [&](const auto & v) { return v.first == name; });
+            if (it == m_values.end()) {
+                it = m_values.insert(it, {name, {}});
+            }
+            it->second.push_back(value);
+        }
+        m_label.clear();
+        return;
+    }
+    }
+}
+
+void TraceExporter::write_footer()
+{
+    if (m_options.format == Format::Npy) {
+        m_out.seekp(0);
+        m_out << npy_header(m_rows, m_dims + 1);
+        return;
+    }
+    if (m_options.format != Format::Matlab) {
+        return;
+    }
+
+    m_out << "];\n";
+    for (const auto & [name, values] : m_values) {
+        m_line = name + " = [";
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            append_number(m_line, values[i]);
+            m_line += (i + 1 == values.size() ? "" : ", ");
+        }
+        m_out << m_line << "];\n";
+    }
+
+    auto [x, y] = m_options.projection;
+    if (m_rows == 0 || x >= m_dims || y >= m_dims) {
+        return;
+    }
+    m_out << "a = points(:, " << x + 1 << ");\n";
+    m_out << "b = points(:, " << y + 1 << ");\n";
+
+    if (!m_options.function.empty()) {
+        std::string axes[2] = {"x", "y"};
+        for (std::size_t k = 0; k < 2; ++k) {
+            double len = std::max(m_max[k] - m_min[k], 1e-9);
+            m_out << axes[k] << " = linspace(" << m_min[k] - len * 0.15 << ", " << m_max[k] + len * 0.15 << ", 100);\n";
+        }
+        m_out << "[X,Y] = meshgrid(x,y);\n";
+        m_out << "Z = " << matlab_expression(m_options.function, x, y, m_last_point) << ";\n";
+        m_out << "contour(X,Y,Z,20);hold on\n";
+    }
+    m_out << "plot(a,b,'-o');\n";
+}
+
+} // namespace util
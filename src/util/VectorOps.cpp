@@ -113,4 +113,9 @@ double length(const VectorT & vec)
     return scalar(vec, vec);
 }
 
+void add_scaled(VectorT & lhs, const VectorT & rhs, double scalar)
+{
+    std::transform(lhs.begin(), lhs.end(), rhs.begin(), lhs.begin(), [scalar](double l, double r) { return l + r * scalar; });
+}
+
 } // namespace util